@@ -0,0 +1,209 @@
+// Fixed-iteration microbenchmarks of the in-process kernels. "make
+// microbench" times a plain -O2 build, then counts allocations in a
+// separate MEMSTAT build whose accounting would skew the timings.
+// Payloads are generated in the RPC v5 format so runs are repeatable
+// without network access.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../include/memory.h"
+#include "../include/list.h"
+#include "../include/rpc.h"
+#include "../include/operation.h"
+
+#define RESULT "{\"ID\":%d,\"Name\":\"pkg%06d\",\"PackageBaseID\":%d,\"PackageBase\":\"pkg%06d\"," \
+                "\"Version\":\"1.%d.0-1\",\"Description\":\"benchmark package %d\",\"URL\":null," \
+                "\"NumVotes\":%d,\"Popularity\":%d.%d,\"OutOfDate\":null,\"Maintainer\":\"bench\"," \
+                "\"FirstSubmitted\":1500000000,\"LastModified\":1700000000,\"URLPath\":\"/cgit/aur.git/snapshot/pkg%06d.tar.gz\"}"
+
+typedef void (*Kernel)(void *arg);
+
+char *make_payload(int n);
+List *make_list(int n, int stride);
+void bench(const char *name, int iters, Kernel kernel, void *arg);
+void run_json(void *arg);
+void run_add_json_data(void *arg);
+void run_add_pkgname(void *arg);
+void run_find_pkg(void *arg);
+void run_mark_installed(void *arg);
+void run_epoch_update(void *arg);
+
+#define QUERIES 1024
+
+typedef struct sized {
+    int n;
+    void *data;
+    List *list;
+    char (*queries)[32];    // precomputed so only the lookup is timed
+    int next;
+} Sized;
+
+int main(void) {
+
+    int sizes[] = {1, 100, 10000}, list_sizes[] = {10, 100, 1000};
+    char name[64], queries[QUERIES][32];
+    Sized arg;
+    List *installed, *pkg;
+    register int i, j;
+
+    srand(1);
+
+    for (i = 0; i < 3; i++) {
+        arg.n = sizes[i];
+        arg.data = make_payload(sizes[i]);
+        snprintf(name, sizeof(name), "json/%d", sizes[i]);
+        bench(name, sizes[i] < 10000 ? 2000 : 20, run_json, &arg);
+        free(arg.data);
+    }
+
+    for (i = 0; i < 3; i++) {
+        arg.n = list_sizes[i];
+        snprintf(name, sizeof(name), "add_json_data/%d", list_sizes[i]);
+        bench(name, 100000 / list_sizes[i], run_add_json_data, &arg);
+        snprintf(name, sizeof(name), "add_pkgname/%d", list_sizes[i]);
+        bench(name, 100000 / list_sizes[i], run_add_pkgname, &arg);
+
+        arg.list = make_list(list_sizes[i], 1);
+        for (j = 0; j < QUERIES; j++) {
+            snprintf(queries[j], sizeof(queries[j]), "pkg%06d", rand() % list_sizes[i]);
+        }
+        arg.queries = queries;
+        arg.next = 0;
+        snprintf(name, sizeof(name), "find_pkg/%d", list_sizes[i]);
+        bench(name, 10000, run_find_pkg, &arg);
+
+        installed = make_list(list_sizes[i], 2);
+        arg.data = installed;
+        snprintf(name, sizeof(name), "mark_installed/%d", list_sizes[i]);
+        bench(name, 1000000 / (list_sizes[i] * list_sizes[i]) + 1, run_mark_installed, &arg);
+        clear_list(installed);
+        clear_list(arg.list);
+    }
+
+    pkg = list_malloc();
+    pkg = add_pkgname(pkg, "bench");
+    add_pkgver(pkg, "bench", "1.2.3-1");
+    arg.list = pkg;
+    bench("epoch_update", 1000000, run_epoch_update, &arg);
+    clear_list(pkg);
+
+    return 0;
+}
+
+// an RPC info response with n results.
+char *make_payload(int n) {
+
+    char *buffer = NULL, result[512];
+    int len, size;
+    register int i;
+
+    size = 64 + n * sizeof(result);
+    str_alloc(&buffer, size);
+    len = sprintf(buffer, "{\"resultcount\":%d,\"results\":[", n);
+    for (i = 0; i < n; i++) {
+        len += sprintf(buffer + len, "%s", i ? "," : "");
+        snprintf(result, sizeof(result), RESULT, i, i, i, i, i, i, rand() % 500, rand() % 20, rand() % 100, i);
+        len += sprintf(buffer + len, "%s", result);
+    }
+    sprintf(buffer + len, "],\"type\":\"multiinfo\",\"version\":5}");
+
+    return buffer;
+}
+
+// n packages named pkgNNNNNN, every stride-th one.
+List *make_list(int n, int stride) {
+
+    char pkgname[32];
+    List *list;
+    register int i;
+
+    list = list_malloc();
+    for (i = 0; i < n; i++) {
+        snprintf(pkgname, sizeof(pkgname), "pkg%06d", i * stride);
+        list = add_pkgname(list, pkgname);
+    }
+
+    return list;
+}
+
+void bench(const char *name, int iters, Kernel kernel, void *arg) {
+
+#ifdef MEMSTAT
+    Mem_stat before, after;
+#else
+    struct timespec start, end;
+    double ns;
+#endif
+    register int i;
+
+    kernel(arg);        // warm up
+
+#ifdef MEMSTAT
+    before = mem_stat();
+    for (i = 0; i < iters; i++) {
+        kernel(arg);
+    }
+    after = mem_stat();
+    printf("%-24s %10d iters %12.1f allocs/op\n", name, iters, \
+            (double)(after.allocs + after.reallocs - before.allocs - before.reallocs) / iters);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < iters; i++) {
+        kernel(arg);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+    printf("%-24s %10d iters %14.1f ns/op\n", name, iters, ns / iters);
+#endif
+}
+
+void run_json(void *arg) {
+
+    clear_list(json(((Sized *)arg)->data));
+}
+
+void run_add_json_data(void *arg) {
+
+    char pkgname[32];
+    List *list;
+    register int i;
+
+    list = list_malloc();
+    for (i = 0; i < ((Sized *)arg)->n; i++) {
+        snprintf(pkgname, sizeof(pkgname), "pkg%06d", i);
+        list = add_json_data(list, pkgname, "1.0.0-1", NULL, (i * 7919) % 1000);
+    }
+    clear_list(list);
+}
+
+void run_add_pkgname(void *arg) {
+
+    clear_list(make_list(((Sized *)arg)->n, 1));
+}
+
+void run_find_pkg(void *arg) {
+
+    Sized *sized = arg;
+
+    if (find_pkg(sized->list, sized->queries[sized->next++ & (QUERIES - 1)]) == NULL) {
+        abort();
+    }
+}
+
+void run_mark_installed(void *arg) {
+
+    Sized *sized = arg;
+
+    mark_installed(sized->list, sized->data);
+}
+
+void run_epoch_update(void *arg) {
+
+    static const char *versions[] = {"1.2.4-1", "1:1.0-1", "2.0-1", "1:2.0-3"};
+    static int i;
+
+    epoch_update(((Sized *)arg)->list, versions[i++ & 3]);
+}
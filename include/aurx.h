@@ -0,0 +1,46 @@
+#ifndef AURX_H
+#define AURX_H
+
+// Public interface of libaurx, the query side of aurx for programs that
+// link it instead of parsing "aurx -q" or "aurx -s" output.
+//
+// An Aurx handle keeps the foreign package list and the metadata store
+// between calls: the list is only reloaded when the pacman databases
+// change and the store stays mapped until "aurx -y" replaces it.
+// Handles are not thread-safe, use one per thread. The library never
+// changes the working directory. Like the aurx binary, it still exits on
+// fatal errors such as a broken alpm setup.
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define AURX_API __attribute__((visibility("default")))
+
+typedef struct aurx Aurx;
+
+typedef struct aurx_pkg {
+    char *name;
+    char *version;          // installed version, the AUR version for search results
+    char *new_version;      // updates only, otherwise NULL
+    int popularity;         // search results only
+    bool installed;
+} Aurx_pkg;
+
+typedef struct aurx_result {
+    Aurx_pkg *pkgs;
+    size_t n;
+} Aurx_result;
+
+// cache_dir is the aurx cache, NULL for ~/.cache/aurx. returns NULL when
+// it does not exist.
+AURX_API Aurx *aurx_open(const char *cache_dir);
+AURX_API void aurx_close(Aurx *aurx);
+
+// each fills *out and returns 0, or -1 when the cache dir is unreachable.
+// an empty result is not an error.
+AURX_API int aurx_installed(Aurx *aurx, Aurx_result *out);
+AURX_API int aurx_search(Aurx *aurx, const char *keyword, Aurx_result *out);
+AURX_API int aurx_updates(Aurx *aurx, Aurx_result *out);
+AURX_API void aurx_result_free(Aurx_result *result);
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdbool.h>
+
+// Retention of the clones in ~/.cache/aurx. Clones of installed packages
+// are kept, the rest go first, then the least recently used until the
+// total fits under the cap ($AURX_CACHE_MAX, in bytes or with a K/M/G suffix).
+#define CACHE_MAX (1LL * 1024 * 1024 * 1024)
+#define CACHE_MAX_ENV "AURX_CACHE_MAX"
+
+int cache_trim(bool prune);
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef CCACHE_H
+#define CCACHE_H
+
+// Opt-in compiler cache for builds, $AURX_CCACHE set to "ccache" or
+// "sccache". Each pkgbase gets its own cache so one large package can't
+// evict the objects of another, clean builds of a -git package then mostly
+// hit the objects of the previous build.
+#define CCACHE_ENV "AURX_CCACHE"
+#define CCACHE_DIR ".ccache"
+#define CCACHE_MAX_SIZE "2G"        // per pkgbase
+#define CCACHE_BIN "/usr/lib/ccache/bin"
+
+void ccache_begin(const char *pkgbase);
+void ccache_end(const char *pkgbase);
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef CHROOT_H
+#define CHROOT_H
+
+#include <stdbool.h>
+
+// Opt-in clean builds, $AURX_CHROOT set to 1. One base root with base-devel
+// is prepared by mkarchroot and refreshed daily, every build then runs in
+// an overlayfs snapshot of it that is thrown away afterwards, so
+// makedepends never reach the host and nothing is copied per build.
+// Builds of different packages (e.g. from several aurx processes) can share
+// the root at the same time, each gets its own overlay.
+#define CHROOT_ENV "AURX_CHROOT"
+#define CHROOT_DIR ".chroot"                // makechrootpkg -r, root/ is the base
+#define LAYERS_DIR CHROOT_DIR"/.layers"     // overlay upper and work dirs
+#define CHROOT_SYNCED CHROOT_DIR"/.synced"  // mtime is the last refresh
+#define CHROOT_MAX_AGE (60 * 60 * 24)
+
+#define MKARCHROOT "sudo mkarchroot '%s/root' base-devel"
+#define CHROOT_UPDATE "sudo arch-nspawn '%s/root' pacman -Syu --noconfirm"
+#define OVERLAY_MOUNT "sudo mkdir -p '%s/upper' '%s/work' '%s' && sudo mount -t overlay overlay " \
+                        "-o lowerdir='%s/root',upperdir='%s/upper',workdir='%s/work' '%s'"
+#define OVERLAY_UMOUNT "if mountpoint -q '%s'; then sudo umount '%s'; fi && sudo rm -rf '%s' '%s'"
+#define MAKECHROOTPKG "cd '%s' && SRCDEST=\"$HOME/.cache/aurx/.sources\" makechrootpkg -r '%s' -l '%s' -- OPTIONS=-debug"
+
+bool chroot_enabled(void);
+bool chroot_build(const char *pkgbase);
+
+#endif
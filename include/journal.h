@@ -0,0 +1,27 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#define JOURNAL ".journal"
+
+typedef struct node List;
+
+// Stages of a package during -u, in order.
+typedef enum stage {
+    NONE = -1,
+    CHECKED,
+    FETCHED,
+    REVIEWED,
+    BUILT,
+    INSTALLED
+} Stage;
+
+List *journal_pending(void);
+void journal_begin(List *updates);
+Stage journal_stage(const char *pkgname);
+void journal_set(const char *pkgname, Stage stage);
+void journal_remove(const char *pkgname);
+void journal_set_rev(const char *pkgname, const char *rev);
+const char *journal_rev(const char *pkgname);
+void journal_end(void);
+
+#endif
@@ -8,6 +8,7 @@
 typedef struct node {
     char *pkgname;
     char *pkgver;
+    char *pkgbase;      // NULL when it matches pkgname
     int pop;
     bool installed;
     bool update;
@@ -17,8 +18,14 @@ typedef struct node {
 List *get_installed_list(void);
 List *add_pkgname(List *list, const char *pkgname);
 void add_pkgver(List *list, const char *pkgname, const char *pkgver);
+void add_pkgbase(List *list, const char *pkgname, const char *pkgbase);
+const char *pkg_base(List *pkg);
 List *find_pkg(List *list, const char *pkgname);
-List *add_json_data(List *list, const char *pkgname, const char *pkgver, int pop);
+List *find_base(List *list, const char *pkgbase);
+List *get_bases(List *list);
+List *split_names(List *list, const char *pkgbase, List *names);
+List *add_json_data(List *list, const char *pkgname, const char *pkgver, const char *pkgbase, int pop);
 List *check_status(List *list);
+List *mark_installed(List *list, List *pkglist);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,20 @@
+#ifndef LOCK_H
+#define LOCK_H
+
+#include <stdbool.h>
+
+// Advisory flock()s under ~/.cache/aurx so several aurx processes can share
+// the cache. Locks are always taken in this order to avoid deadlocks:
+// journal, metadata, packages, chroot, sources, then the .SRCINFO index.
+#define LOCK_DIR ".locks"
+#define JOURNAL_LOCK LOCK_DIR"/.journal.lock"
+#define META_LOCK LOCK_DIR"/.meta.lock"
+#define SOURCES_LOCK LOCK_DIR"/.sources.lock"
+#define CHROOT_LOCK LOCK_DIR"/.chroot.lock"
+#define INDEX_LOCK LOCK_DIR"/.index.lock"
+
+int lock_file(const char *path, bool exclusive);
+int lock_pkg(const char *pkgname);
+void unlock(int fd);
+
+#endif
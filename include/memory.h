@@ -1,14 +1,51 @@
 #ifndef MEMORY_H
 #define MEMORY_H
 
+#include <stddef.h>
+
 #define NAME_LEN 100
 
 typedef struct node List;
 typedef struct curl Json_buffer;
+typedef struct store Store;
 
 void str_alloc(char **ptr, int size);
+void *array_alloc(void *ptr, size_t size);
 List *list_malloc(void);
 void clear_list(List *list);
 Json_buffer *json_buffer_malloc(void);  
+Store *store_malloc(void);
+
+#ifdef MEMSTAT
+typedef struct mem_stat {
+    long allocs;
+    long reallocs;
+    long frees;
+    long long live;
+    long long peak;
+} Mem_stat;
+
+void mem_site(const char *file, int line);
+void mem_op(const char *op);
+void mem_free(void *ptr, const char *file, int line);
+Mem_stat mem_stat(void);
+
+// record the caller of every allocator.
+#ifndef MEMORY_INTERNAL
+#define str_alloc(ptr, size) (mem_site(__FILE__, __LINE__), str_alloc(ptr, size))
+#define array_alloc(ptr, size) (mem_site(__FILE__, __LINE__), array_alloc(ptr, size))
+#define list_malloc() (mem_site(__FILE__, __LINE__), list_malloc())
+#define clear_list(list) (mem_site(__FILE__, __LINE__), clear_list(list))
+#define json_buffer_malloc() (mem_site(__FILE__, __LINE__), json_buffer_malloc())
+#define store_malloc() (mem_site(__FILE__, __LINE__), store_malloc())
+#endif
+
+// mem_free() only counts blocks it tracks, anything else is just freed.
+// stdlib.h comes first so its declaration of free() is not rewritten.
+#ifndef MEMORY_INTERNAL
+#include <stdlib.h>
+#define free(ptr) mem_free(ptr, __FILE__, __LINE__)
+#endif
+#endif
 
 #endif
\ No newline at end of file
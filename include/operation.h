@@ -1,15 +1,25 @@
 #ifndef OPERATION_H
 #define OPERATION_H
 
+#include <stdbool.h>
+
 typedef struct node List;
+typedef struct store Store;
 
 void target_clone(char *url);
+void aur_install(List *list);
 void aur_clone(char *pkgnmae);
 void uninstall(List *list);
 void clean(void);
 void print_search(char *pkgname);
 void print_installed(void);
 void update(void);
-void force_update(char *pkgname);
+void prefetch(void);
+List *get_updates(List *pkglist, Store *store, bool print);
+void install_updates(List *updates);
+void run_updates(List *updates);
+void fetch_update(const char *pkgname, const char *pkgver);
+void force_update(List *list);
+bool epoch_update(List *pkg, const char *pkgver);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,9 @@
+#ifndef POOL_H
+#define POOL_H
+
+typedef void (*Job)(int i, void *arg);
+
+int pool_size(void);
+void run_pool(int threads, int n, Job job, void *arg);
+
+#endif
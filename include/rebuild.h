@@ -0,0 +1,6 @@
+#ifndef REBUILD_H
+#define REBUILD_H
+
+void rebuild(void);
+
+#endif
@@ -6,10 +6,15 @@ typedef struct curl {
     int size;
 } Json_buffer;
 
+#define RPC_JOBS 8
+
 typedef struct node List;
+typedef void (*Rpc_callback)(int i, List *rpc_pkg, void *arg);
 
+void curl_init(void);
 char *curl(Json_buffer *buffer, char *url);
 List *get_rpc_data(char *url);
+void get_rpc_multi(char **urls, int n, Rpc_callback done, void *arg);
 List *json(char *buffer); 
 void fetch_meta(void);
 
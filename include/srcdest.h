@@ -0,0 +1,17 @@
+#ifndef SRCDEST_H
+#define SRCDEST_H
+
+// makepkg's SRCDEST, shared by every package and kept by -c.
+#define SOURCES_DIR ".sources"
+#define OBJECTS_DIR SOURCES_DIR"/.objects"
+#define SOURCES_MAX (4LL * 1024 * 1024 * 1024)     // bytes kept in SOURCES_DIR
+#define SOURCE_JOBS 8
+#define CHECKSUM "%s '%s' 2> /dev/null"
+
+typedef struct node List;
+
+void source_prefetch(List *pkglist);
+void source_link(const char *pkgname);
+void source_trim(void);
+
+#endif
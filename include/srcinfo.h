@@ -0,0 +1,35 @@
+#ifndef SRCINFO_H
+#define SRCINFO_H
+
+#include <stdint.h>
+
+#define SRCINFO "%s/.SRCINFO"
+
+// Binary index of the .SRCINFO of every cached repo, so lookups don't
+// reparse the file. A record is refreshed when the repo's HEAD or its
+// .SRCINFO changes, and only the keys aurx reads are kept: pkgbase,
+// pkgname, the version, arch, dependencies, sources and checksums.
+#define SRCINFO_INDEX ".srcinfo.index"
+#define SRCINFO_MAGIC "AURXIDX1"
+#define HEAD_LEN 64
+#define SRCINFO_MAX_RECORD (1 << 20)
+
+typedef struct node List;
+
+// On-disk record header, followed by blob_len bytes: the dir, then
+// n_pairs key and value strings, all NUL terminated.
+typedef struct srcinfo_record {
+    char head[HEAD_LEN];        // commit HEAD pointed to
+    int64_t mtime;              // of the .SRCINFO
+    int64_t mtime_nsec;
+    int64_t size;
+    uint32_t n_pairs;
+    uint32_t blob_len;
+} Srcinfo_record;
+
+List *srcinfo_get(const char *dir, const char *key);
+char *srcinfo_first(const char *dir, const char *key);
+char *srcinfo_version(const char *dir);
+void read_head(const char *dir, char *head);
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef STORE_H
+#define STORE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define STORE_MAGIC "AURXSTR2"
+#define STORE_NO_BASE UINT32_MAX     // pkgbase is the package name
+
+typedef struct node List;
+
+// Columnar copy of the AUR metadata dump, one row per package.
+// Names are stored back to back at the start of the blob followed by
+// versions and the pkgbases of split packages, so a search only walks
+// the name region. The file is mapped
+// read-only, pages are only touched when they are scanned.
+typedef struct store {
+    void *map;
+    size_t map_size;
+    uint32_t n;
+    const uint32_t *name;       // offsets into blob
+    const uint32_t *ver;        // offsets into blob
+    const uint32_t *base;       // offsets into blob, or STORE_NO_BASE
+    const int32_t *pop;
+    const uint32_t *index;      // rows sorted by name
+    const char *blob;
+} Store;
+
+// On-disk header, followed by the name, ver, base, pop and index columns and the blob.
+typedef struct store_header {
+    char magic[8];
+    uint32_t n;
+    uint32_t blob_len;
+} Store_header;
+
+void store_build(void);
+Store *store_load(void);
+Store *store_open(const char *dir);
+void store_free(Store *store);
+int store_find(Store *store, const char *pkgname);
+const char *store_pkgname(Store *store, int row);
+const char *store_pkgver(Store *store, int row);
+const char *store_pkgbase(Store *store, int row);
+List *store_search(Store *store, const char *keyword);
+
+#endif
@@ -13,10 +13,15 @@
 #define AUR_SEARCH "https://aur.archlinux.org/rpc/v5/search/%s?by=name"
 #define AUR_PKG "https://aur.archlinux.org/rpc/v5/info?arg[]=%s"
 #define LESS_PKGBUILD "cd %s && less PKGBUILD"
-#define MAKEPKG "cd %s && makepkg -sirc OPTIONS=-debug && git clean -dfx"
+#define MAKEPKG_BUILD "cd %s && SRCDEST=\"$HOME/.cache/aurx/.sources\" makepkg -src OPTIONS=-debug"
+#define MAKEPKG_INSTALL "cd %s && makepkg -i OPTIONS=-debug && git clean -dfx"    // installs the package built above
+#define MAKEPKG_LIST "cd %s && makepkg --packagelist OPTIONS=-debug"
+#define PACMAN_INSTALL "cd %s && sudo pacman -U"            // followed by the package files
 #define UNINSTALL "sudo pacman -Rsc"
 #define META ".packages-meta-v1.json.gz"
 #define META_LINK "https://aur.archlinux.org/packages-meta-v1.json.gz"
+#define STORE ".packages.store"
+#define META_MAX_AGE (60 * 60 * 24)     // seconds before the store is considered stale
 
 // Console colours
 #define RESET "\e[0m"
@@ -34,10 +39,18 @@ typedef struct node List;
 
 char *get_buffer(const char *cmd);
 void get_str(char **str, const char *p, const char *str_var);
-bool is_dir(char *pkgname);
-bool file_exists(char *path);
+bool is_dir(const char *pkgname);
+bool file_exists(const char *path);
 bool prompt(void);
-void remove_dir(char *path);
+void remove_dir(const char *path);
 List *get_dir_list(void);
 
+#if defined(MEMSTAT) && !defined(UTIL_INTERNAL)
+void mem_site(const char *file, int line);
+
+// most strings are allocated through these, record their callers instead.
+#define get_buffer(cmd) (mem_site(__FILE__, __LINE__), get_buffer(cmd))
+#define get_str(str, p, str_var) (mem_site(__FILE__, __LINE__), get_str(str, p, str_var))
+#endif
+
 #endif
\ No newline at end of file
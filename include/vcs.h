@@ -0,0 +1,14 @@
+#ifndef VCS_H
+#define VCS_H
+
+#define VCS_DIR ".vcs"
+#define VCS_JOBS 16
+#define GIT_LS_REMOTE "GIT_TERMINAL_PROMPT=0 git ls-remote '%s' '%s' 2> /dev/null"
+#define SVN_INFO "svn info --non-interactive --show-item revision '%s' 2> /dev/null"
+#define HG_IDENTIFY "hg identify --noninteractive '%s' 2> /dev/null"
+#define HG_IDENTIFY_BRANCH "hg identify --noninteractive -r '%s' '%s' 2> /dev/null"
+
+void vcs_update(void);
+void vcs_commit(const char *pkgname);
+
+#endif
@@ -9,12 +9,17 @@
 #include "../include/rpc.h"
 #include "../include/list.h"
 #include "../include/util.h"
+#include "../include/rebuild.h"
+#include "../include/vcs.h"
 
 void set_dir(void);
 
 int main(int argc, char *argv[]) {
 
 	register int i;
+#ifdef MEMSTAT
+	mem_op(argc > 1 ? argv[1] : "none");
+#endif
 	set_dir();
 
 	if (argc == 1) {
@@ -22,28 +27,46 @@ int main(int argc, char *argv[]) {
 	} else if (strcmp(argv[1], "-h") == 0) {
 		printf("Usage:\taurx <operation> [...]\nOperations:\n");
         printf(" -u\t\t\t\t\tupdate and upgrade.\n");
+		printf(" -d\t\t\t\t\tupdate VCS (-git/-svn/-hg) packages whose upstream changed.\n");
+		printf(" -p\t\t\t\t\tfetch pending updates in the background, no prompts or builds.\n");
 		printf(" -U [package(s)]\t\t\tforce update package(s).\n");
 		printf(" -i [package(s)]\t\t\tinstall package(s).\n");
 		printf(" -x [git clone URL]\t\t\tinstall specified target from a git repo");
+		printf(" -b\t\t\t\t\tfind packages linking against missing libraries, offer to rebuild.\n");
 		printf(" -c\t\t\t\t\tclean ~/.cache/aurx dir.\n");
 		printf(" -q\t\t\t\t\tlist installed packages.\n");
 		printf(" -r [package(s)]\t\t\tuninstall package(s).\n");
 		printf(" -s [package]\t\t\t\tsearch package on AUR.\n");
+		printf(" -y\t\t\t\t\trefresh AUR metadata used for searches and update checks.\n");
 	} else if (strcmp(argv[1], "-u") == 0) {
 		update();
+	} else if (strcmp(argv[1], "-d") == 0) {
+		vcs_update();
+	} else if (strcmp(argv[1], "-p") == 0) {
+		prefetch();
 	}  else if (strcmp(argv[1], "-U") == 0) {		// Doesn't order updates alphabetically (would be nice).
 		if (argc > 2) {
+			List *list;
+
+			list = list_malloc();
 			for (i = 2; i < argc; i++) {
-				force_update(argv[i]);
+				list = add_pkgname(list, argv[i]);
 			}
+			force_update(list);
+			clear_list(list);
 		} else {
 			printf("Please specify package(s), use -h for help.\n");
 		}
 	} else if (strcmp(argv[1], "-i") == 0) {
 		if (argc > 2) {
+			List *list;
+
+			list = list_malloc();
 			for (i = 2; i < argc; i++) {
-				aur_clone(argv[i]);
+				list = add_pkgname(list, argv[i]);
 			}
+			aur_install(list);
+			clear_list(list);
 		} else {
 			printf("Please specify package(s), use -h for help.\n");
 		}
@@ -55,6 +78,8 @@ int main(int argc, char *argv[]) {
 		} else {
 			printf("Please specify a target URL, use -h for help.\n");
 		}
+	} else if (strcmp(argv[1], "-b") == 0) {
+		rebuild();
 	} else if (strcmp(argv[1], "-c") == 0) { 
 		clean();
 	} else if (strcmp(argv[1], "-q") == 0) {
@@ -80,6 +105,9 @@ int main(int argc, char *argv[]) {
 		} else {
 			printf("Please specify a search keyword, use -h for help.\n");
 		}
+	} else if (strcmp(argv[1], "-y") == 0) {
+		printf(BBLUE"::"BOLD" Refreshing AUR metadata...\n"RESET);
+		fetch_meta();
 	} else {
 		printf("Unkown operation, use -h for help.\n");
 	}
@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "../include/cache.h"
+#include "../include/memory.h"
+#include "../include/list.h"
+#include "../include/util.h"
+#include "../include/lock.h"
+#include "../include/ccache.h"
+#include "../include/journal.h"
+
+typedef struct entry {
+    char *pkgname;
+    long long size;
+    time_t used;            // newest mtime in the clone, pulls and builds both touch it
+    bool installed;
+} Entry;
+
+long long cache_max(void);
+void walk(const char *path, Entry *entry);
+int compare_entries(const void *a, const void *b);
+
+// with prune set (-c) every clone of a package that is not installed is
+// removed, otherwise (after -u) clones are only removed to meet the cap.
+// clones an unfinished -u still needs are kept. returns the number removed.
+int cache_trim(bool prune) {
+
+    char *ccache = NULL;
+    List *dir, *installed, *pending, *temp;
+    Entry *entries;
+    long long total = 0, max, freed = 0;
+    time_t used;
+    int n, fd, journal_fd, removed = 0;
+    register int i;
+
+    dir = get_dir_list();
+    if (dir == NULL) {
+        return 0;
+    }
+    installed = get_installed_list();
+
+    // a resumed -u skips the fetch of anything past CHECKED, so those
+    // clones have to stay until the run is finished.
+    journal_fd = lock_file(JOURNAL_LOCK, false);
+    pending = journal_pending();
+
+    for (n = 0, temp = dir; temp != NULL; temp = temp->next) {
+        n++;
+    }
+    entries = array_alloc(NULL, n * sizeof(Entry));
+    for (i = 0, temp = dir; temp != NULL; i++, temp = temp->next) {
+        entries[i].pkgname = temp->pkgname;
+        entries[i].size = 0;
+        entries[i].used = 0;
+        entries[i].installed = find_base(installed, temp->pkgname) != NULL;
+        walk(temp->pkgname, &entries[i]);
+        total += entries[i].size;
+    }
+
+    max = cache_max();
+    qsort(entries, n, sizeof(Entry), compare_entries);
+    for (i = 0; i < n && (total > max || (prune && !entries[i].installed)); i++) {
+        if (pending != NULL && find_pkg(pending, entries[i].pkgname) != NULL) {
+            continue;
+        }
+
+        // measure again under the lock, another aurx may have pulled,
+        // built or removed it in the meantime.
+        fd = lock_pkg(entries[i].pkgname);
+        used = entries[i].used;
+        total -= entries[i].size;
+        entries[i].size = 0;
+        entries[i].used = 0;
+        walk(entries[i].pkgname, &entries[i]);
+        total += entries[i].size;
+        if (entries[i].size == 0 || (entries[i].used > used && (prune == false || entries[i].installed))) {
+            unlock(fd);
+            continue;
+        }
+        remove_dir(entries[i].pkgname);
+        unlock(fd);
+
+        // its compiler cache goes with it.
+        get_str(&ccache, CCACHE_DIR"/%s", entries[i].pkgname);
+        if (is_dir(ccache) == true) {
+            remove_dir(ccache);
+        }
+        total -= entries[i].size;
+        freed += entries[i].size;
+        removed++;
+    }
+    clear_list(pending);
+    unlock(journal_fd);
+    if (removed > 0) {
+        printf(BBLUE"=>"BOLD" Removed %d cached repos (%lld KiB), %lld KiB kept.\n"RESET, \
+                removed, freed >> 10, total >> 10);
+    }
+
+    free(ccache);
+    free(entries);
+    clear_list(installed);
+    clear_list(dir);
+
+    return removed;
+}
+
+// byte cap from the environment, CACHE_MAX when unset or invalid.
+long long cache_max(void) {
+
+    char *env, *end;
+    long long max;
+
+    env = getenv(CACHE_MAX_ENV);
+    if (env == NULL) {
+        return CACHE_MAX;
+    }
+    max = strtoll(env, &end, 10);
+    switch (*end) {
+        case 'G': case 'g':
+            max <<= 10;
+            /* fall through */
+        case 'M': case 'm':
+            max <<= 10;
+            /* fall through */
+        case 'K': case 'k':
+            max <<= 10;
+            end++;
+            break;
+    }
+    if (end == env || *end != '\0' || max < 0) {
+        printf(BYELLOW"WARNING:"BOLD" Ignoring invalid %s.\n"RESET, CACHE_MAX_ENV);
+        return CACHE_MAX;
+    }
+
+    return max;
+}
+
+// add up the disk usage of path and everything below it.
+void walk(const char *path, Entry *entry) {
+
+    DIR *dir;
+    struct dirent *p;
+    struct stat st;
+    char *sub = NULL;
+
+    if (lstat(path, &st) < 0) {
+        return;
+    }
+    entry->size += (long long)st.st_blocks * 512;
+    if (st.st_mtime > entry->used) {
+        entry->used = st.st_mtime;
+    }
+    if (!S_ISDIR(st.st_mode) || (dir = opendir(path)) == NULL) {
+        return;
+    }
+
+    while ((p = readdir(dir)) != NULL) {
+        if (strcmp(p->d_name, ".") == 0 || strcmp(p->d_name, "..") == 0) {
+            continue;
+        }
+        str_alloc(&sub, strlen(path) + strlen(p->d_name) + 2);
+        sprintf(sub, "%s/%s", path, p->d_name);
+        walk(sub, entry);
+    }
+    closedir(dir);
+    free(sub);
+}
+
+// uninstalled first, then least recently used.
+int compare_entries(const void *a, const void *b) {
+
+    const Entry *x = a, *y = b;
+
+    if (x->installed != y->installed) {
+        return x->installed - y->installed;
+    }
+    return (x->used > y->used) - (x->used < y->used);
+}
@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "../include/ccache.h"
+#include "../include/memory.h"
+#include "../include/util.h"
+
+// counters of "ccache --print-stats" and "sccache --show-stats".
+static const char *ccache_hits[] = {"direct_cache_hit", "preprocessed_cache_hit", NULL};
+static const char *sccache_hits[] = {"Cache hits", NULL};
+
+typedef enum {
+    NO_CACHE,
+    CCACHE,
+    SCCACHE
+} Cache_tool;
+
+Cache_tool cache_tool(void);
+char *cache_dir(const char *pkgbase);
+void read_stats(const char *cmd, const char **hit_keys, const char *miss_key, long long *hits, long long *misses);
+long long stat_value(const char *line, const char *key);
+
+static Cache_tool active = NO_CACHE;    // set between ccache_begin() and ccache_end()
+static char *saved_path;
+
+// point the environment makepkg inherits at the pkgbase's cache and
+// reset its statistics so ccache_end() reports this build only.
+void ccache_begin(const char *pkgbase) {
+
+    char *dir, *path = NULL;
+    Cache_tool tool;
+
+    tool = cache_tool();
+    if (tool == NO_CACHE) {
+        return;
+    }
+    if (tool == CCACHE && is_dir(CCACHE_BIN) == false) {
+        printf(BYELLOW"WARNING:"BOLD" %s not found, building without ccache.\n"RESET, CCACHE_BIN);
+        return;
+    }
+    active = tool;
+
+    mkdir(CCACHE_DIR, 0755);
+    dir = cache_dir(pkgbase);
+    mkdir(dir, 0755);
+    if (tool == CCACHE) {
+        setenv("CCACHE_DIR", dir, 1);
+        setenv("CCACHE_MAXSIZE", CCACHE_MAX_SIZE, 1);
+        system("ccache -z > /dev/null");
+
+        get_str(&saved_path, "%s", getenv("PATH"));
+        str_alloc(&path, strlen(CCACHE_BIN) + strlen(saved_path) + 2);
+        sprintf(path, CCACHE_BIN":%s", saved_path);
+        setenv("PATH", path, 1);
+        free(path);
+    } else {
+        // the server keeps the dir it was started with.
+        system("sccache --stop-server > /dev/null 2>&1");
+        setenv("SCCACHE_DIR", dir, 1);
+        setenv("SCCACHE_CACHE_SIZE", CCACHE_MAX_SIZE, 1);
+        setenv("RUSTC_WRAPPER", "sccache", 1);
+        setenv("CMAKE_C_COMPILER_LAUNCHER", "sccache", 1);
+        setenv("CMAKE_CXX_COMPILER_LAUNCHER", "sccache", 1);
+    }
+    free(dir);
+}
+
+// report the hit rate of the build and restore the environment.
+void ccache_end(const char *pkgbase) {
+
+    long long hits = 0, misses = 0;
+
+    if (active == NO_CACHE) {
+        return;
+    }
+
+    if (active == CCACHE) {
+        read_stats("ccache --print-stats", ccache_hits, "cache_miss", &hits, &misses);
+        if (saved_path != NULL) {
+            setenv("PATH", saved_path, 1);
+            free(saved_path);
+            saved_path = NULL;
+        }
+        unsetenv("CCACHE_DIR");
+        unsetenv("CCACHE_MAXSIZE");
+    } else {
+        read_stats("sccache --show-stats", sccache_hits, "Cache misses", &hits, &misses);
+        system("sccache --stop-server > /dev/null 2>&1");
+        unsetenv("SCCACHE_DIR");
+        unsetenv("SCCACHE_CACHE_SIZE");
+        unsetenv("RUSTC_WRAPPER");
+        unsetenv("CMAKE_C_COMPILER_LAUNCHER");
+        unsetenv("CMAKE_CXX_COMPILER_LAUNCHER");
+    }
+    active = NO_CACHE;
+
+    if (hits + misses == 0) {
+        printf(BBLUE"=>"BOLD" %s: no cacheable compilations.\n"RESET, pkgbase);
+    } else {
+        printf(BBLUE"=>"BOLD" %s: %lld cache hits, %lld misses (%lld%%).\n"RESET, \
+                pkgbase, hits, misses, hits * 100 / (hits + misses));
+    }
+}
+
+Cache_tool cache_tool(void) {
+
+    char *env;
+
+    env = getenv(CCACHE_ENV);
+    if (env == NULL || *env == '\0' || strcmp(env, "0") == 0) {
+        return NO_CACHE;
+    } else if (strcmp(env, "sccache") == 0) {
+        return SCCACHE;
+    }
+    return CCACHE;
+}
+
+// makepkg runs from the clone, so the cache needs an absolute path.
+char *cache_dir(const char *pkgbase) {
+
+    char cwd[MAX_BUFFER], *dir = NULL;
+
+    if (getcwd(cwd, MAX_BUFFER) == NULL) {
+        cwd[0] = '\0';
+    }
+    str_alloc(&dir, strlen(cwd) + strlen(CCACHE_DIR) + strlen(pkgbase) + 3);
+    sprintf(dir, "%s/"CCACHE_DIR"/%s", cwd, pkgbase);
+
+    return dir;
+}
+
+// add up the counters printed by cmd as "<key> <value>" lines.
+void read_stats(const char *cmd, const char **hit_keys, const char *miss_key, long long *hits, long long *misses) {
+
+    char line[MAX_BUFFER];
+    long long value;
+    FILE *p;
+    register int i;
+
+    p = popen(cmd, "r");
+    if (p == NULL) {
+        return;
+    }
+    while (fgets(line, MAX_BUFFER, p) != NULL) {
+        for (i = 0; hit_keys[i] != NULL; i++) {
+            if ((value = stat_value(line, hit_keys[i])) >= 0) {
+                *hits += value;
+            }
+        }
+        if ((value = stat_value(line, miss_key)) >= 0) {
+            *misses += value;
+        }
+    }
+    pclose(p);
+}
+
+// value of key on line, -1 when the line holds another counter (including
+// longer ones such as "Cache hits rate").
+long long stat_value(const char *line, const char *key) {
+
+    size_t len;
+
+    len = strlen(key);
+    if (strncmp(line, key, len) != 0 || (line[len] != ' ' && line[len] != '\t')) {
+        return -1;
+    }
+    for (line += len; *line == ' ' || *line == '\t'; line++);
+    if (*line < '0' || *line > '9') {
+        return -1;
+    }
+    return atoll(line);
+}
@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "../include/chroot.h"
+#include "../include/memory.h"
+#include "../include/util.h"
+#include "../include/lock.h"
+
+bool prepare_root(const char *chroot);
+char *format(const char *fmt, ...);
+
+bool chroot_enabled(void) {
+
+    char *env;
+
+    env = getenv(CHROOT_ENV);
+    return env != NULL && *env != '\0' && strcmp(env, "0") != 0;
+}
+
+// build pkgbase in a fresh overlay of the base root. makechrootpkg leaves
+// the packages in the clone, where the install step expects them.
+bool chroot_build(const char *pkgbase) {
+
+    char cwd[MAX_BUFFER], *chroot, *name, *copy, *layer, *clone, *cmd;
+    int fd, res;
+
+    if (getcwd(cwd, MAX_BUFFER) == NULL) {
+        printf(BRED"ERROR:"BOLD" Failed to get the cache dir.\n"RESET);
+        return false;
+    }
+    chroot = format("%s/"CHROOT_DIR, cwd);
+    name = format("aurx-%s", pkgbase);
+    copy = format("%s/%s", chroot, name);
+    layer = format("%s/"LAYERS_DIR"/%s", cwd, pkgbase);
+    clone = format("%s/%s", cwd, pkgbase);
+
+    // the root is only changed under the exclusive lock, builds keep a
+    // shared one while their overlay sits on top of it.
+    fd = lock_file(CHROOT_LOCK, true);
+    res = prepare_root(chroot);
+    unlock(fd);
+    if (res == false) {
+        free(chroot);
+        free(name);
+        free(copy);
+        free(layer);
+        free(clone);
+        return false;
+    }
+    fd = lock_file(CHROOT_LOCK, false);
+
+    // a build that was interrupted may have left its overlay behind.
+    cmd = format(OVERLAY_UMOUNT, copy, copy, copy, layer);
+    system(cmd);
+    free(cmd);
+
+    printf(BBLUE"=>"BOLD" Building %s in a clean chroot...\n"RESET, pkgbase);
+    cmd = format(OVERLAY_MOUNT, layer, layer, copy, chroot, layer, layer, copy);
+    res = system(cmd);
+    free(cmd);
+    if (res == 0) {
+        cmd = format(MAKECHROOTPKG, clone, chroot, name);
+        res = system(cmd);
+        free(cmd);
+    } else {
+        printf(BRED"ERROR:"BOLD" Failed to mount the build overlay for %s.\n"RESET, pkgbase);
+    }
+
+    cmd = format(OVERLAY_UMOUNT, copy, copy, copy, layer);
+    system(cmd);
+    free(cmd);
+    unlock(fd);
+
+    free(chroot);
+    free(name);
+    free(copy);
+    free(layer);
+    free(clone);
+
+    return res == 0;
+}
+
+// create the base root on first use and keep it up to date.
+bool prepare_root(const char *chroot) {
+
+    char *cmd, *root;
+    struct stat st;
+    bool fresh;
+
+    root = format("%s/root", chroot);
+    fresh = is_dir(root) == false;
+    free(root);
+
+    if (fresh) {
+        printf(BBLUE"::"BOLD" Creating the clean chroot in %s...\n"RESET, chroot);
+        mkdir(CHROOT_DIR, 0755);
+        cmd = format(MKARCHROOT, chroot);
+    } else if (stat(CHROOT_SYNCED, &st) < 0 || time(NULL) - st.st_mtime > CHROOT_MAX_AGE) {
+        printf(BBLUE"::"BOLD" Updating the clean chroot...\n"RESET);
+        cmd = format(CHROOT_UPDATE, chroot);
+    } else {
+        return true;
+    }
+
+    if (system(cmd) != 0) {
+        printf(BRED"ERROR:"BOLD" Failed to prepare the clean chroot.\n"RESET);
+        free(cmd);
+        return false;
+    }
+    free(cmd);
+    close(open(CHROOT_SYNCED, O_WRONLY | O_CREAT | O_TRUNC, 0644));
+
+    return true;
+}
+
+// printf into a new string.
+char *format(const char *fmt, ...) {
+
+    char *str = NULL;
+    va_list args;
+    int len;
+
+    va_start(args, fmt);
+    len = vsnprintf(NULL, 0, fmt, args);
+    va_end(args);
+
+    str_alloc(&str, len + 1);
+    va_start(args, fmt);
+    vsnprintf(str, len + 1, fmt, args);
+    va_end(args);
+
+    return str;
+}
@@ -0,0 +1,263 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/journal.h"
+#include "../include/memory.h"
+#include "../include/list.h"
+#include "../include/util.h"
+#include "../include/srcinfo.h"
+
+// The journal of the running -u lives in memory and is rewritten in full
+// on every change, it only ever holds one update run.
+typedef struct entry {
+    char *pkgname;
+    char *pkgver;       // version being updated to
+    char *rev;          // upstream revision of a -d update, "-" otherwise
+    char *head;         // commit the PKGBUILD was reviewed at, "-" before
+    Stage stage;
+} Entry;
+
+static Entry *entries;
+static int n_entries;
+
+static const char *stages[] = {"checked", "fetched", "reviewed", "built", "installed"};
+
+void journal_read(void);
+void journal_write(void);
+Entry *find_entry(const char *pkgname);
+void free_entry(Entry *entry);
+
+// packages an interrupted run didn't install, with the version it was
+// updating to as pkgver. NULL when there is nothing to resume.
+List *journal_pending(void) {
+
+    List *list;
+    register int i;
+
+    journal_read();
+    list = list_malloc();
+    for (i = 0; i < n_entries; i++) {
+        if (entries[i].stage != INSTALLED) {
+            list = add_pkgname(list, entries[i].pkgname);
+            add_pkgver(list, entries[i].pkgname, entries[i].pkgver);
+        }
+    }
+
+    if (list->pkgname == NULL) {
+        clear_list(list);
+        return NULL;
+    }
+    return list;
+}
+
+// track every package of an update run, keeping the stage of those
+// already known from a resumed run.
+void journal_begin(List *updates) {
+
+    Entry *entry;
+
+    journal_read();
+    for (; updates != NULL; updates = updates->next) {
+        entry = find_entry(updates->pkgname);
+        if (entry != NULL && (updates->pkgver == NULL || strcmp(entry->pkgver, updates->pkgver) == 0)) {
+            continue;
+        }
+        if (entry == NULL) {
+            entries = array_alloc(entries, (n_entries + 1) * sizeof(Entry));
+            entry = &entries[n_entries++];
+            entry->pkgname = NULL;
+            get_str(&entry->pkgname, "%s", updates->pkgname);
+        } else {
+            free(entry->pkgver);
+            free(entry->rev);
+            free(entry->head);
+        }
+        entry->pkgver = entry->rev = entry->head = NULL;
+        get_str(&entry->pkgver, "%s", updates->pkgver ? updates->pkgver : "-");     // VCS updates have no version
+        get_str(&entry->rev, "%s", "-");
+        get_str(&entry->head, "%s", "-");
+        entry->stage = CHECKED;
+    }
+    journal_write();
+}
+
+// NONE for packages outside the current update run (-i, -U, -x). -p and
+// -U pull without looking at the journal, a review (and a build) only
+// stands while the repo is still at the commit that was reviewed.
+Stage journal_stage(const char *pkgname) {
+
+    Entry *entry;
+    char head[HEAD_LEN] = "-";
+
+    entry = find_entry(pkgname);
+    if (entry == NULL) {
+        return NONE;
+    }
+    if (entry->stage == REVIEWED || entry->stage == BUILT) {
+        read_head(pkgname, head);
+        if (strcmp(entry->head, head) != 0) {
+            printf(BYELLOW"WARNING:"BOLD" %s changed since it was reviewed.\n"RESET, pkgname);
+            entry->stage = FETCHED;
+            journal_write();
+        }
+    }
+    return entry->stage;
+}
+
+void journal_set(const char *pkgname, Stage stage) {
+
+    Entry *entry;
+    char head[HEAD_LEN] = "-";
+
+    entry = find_entry(pkgname);
+    if (entry == NULL || entry->stage >= stage) {
+        return;
+    }
+    if (stage == REVIEWED) {
+        read_head(pkgname, head);
+        free(entry->head);
+        entry->head = NULL;
+        get_str(&entry->head, "%s", head);
+    }
+    entry->stage = stage;
+    journal_write();
+}
+
+// the user declined the package, a later -u must not offer to resume it.
+void journal_remove(const char *pkgname) {
+
+    Entry *entry;
+
+    entry = find_entry(pkgname);
+    if (entry == NULL) {
+        return;
+    }
+    free_entry(entry);
+    *entry = entries[--n_entries];
+    journal_write();
+}
+
+// the upstream revision a -d update is built from, recorded by vcs_commit()
+// once it is installed so a resumed run doesn't lose it.
+void journal_set_rev(const char *pkgname, const char *rev) {
+
+    Entry *entry;
+
+    entry = find_entry(pkgname);
+    if (entry == NULL || strcmp(entry->rev, rev) == 0) {
+        return;
+    }
+    free(entry->rev);
+    entry->rev = NULL;
+    get_str(&entry->rev, "%s", rev);
+    journal_write();
+}
+
+// NULL outside a -d update.
+const char *journal_rev(const char *pkgname) {
+
+    Entry *entry;
+
+    entry = find_entry(pkgname);
+    if (entry == NULL || strcmp(entry->rev, "-") == 0) {
+        return NULL;
+    }
+    return entry->rev;
+}
+
+// the run is complete (or abandoned), forget it.
+void journal_end(void) {
+
+    register int i;
+
+    for (i = 0; i < n_entries; i++) {
+        free_entry(&entries[i]);
+    }
+    free(entries);
+    entries = NULL;
+    n_entries = 0;
+    remove(JOURNAL);
+}
+
+// one "pkgname stage pkgver rev head" line per package.
+void journal_read(void) {
+
+    FILE *f;
+    char line[MAX_BUFFER], pkgname[MAX_BUFFER], stage[NAME_LEN], pkgver[MAX_BUFFER], rev[MAX_BUFFER];
+    char head[HEAD_LEN];
+    Entry *entry;
+    register int i;
+
+    if (entries != NULL) {
+        return;
+    }
+    f = fopen(JOURNAL, "r");
+    if (f == NULL) {
+        return;
+    }
+    while (fgets(line, MAX_BUFFER, f) != NULL) {
+        // older journals lack the trailing fields. without a head a
+        // review no longer counts and is asked for again.
+        strcpy(rev, "-");
+        strcpy(head, "-");
+        if (sscanf(line, "%1023s %99s %1023s %1023s %63s", pkgname, stage, pkgver, rev, head) < 3) {
+            continue;
+        }
+        for (i = 0; i <= INSTALLED && strcmp(stages[i], stage) != 0; i++);
+        if (i > INSTALLED) {
+            continue;
+        }
+        entries = array_alloc(entries, (n_entries + 1) * sizeof(Entry));
+        entry = &entries[n_entries++];
+        entry->pkgname = entry->pkgver = entry->rev = entry->head = NULL;
+        get_str(&entry->pkgname, "%s", pkgname);
+        get_str(&entry->pkgver, "%s", pkgver);
+        get_str(&entry->rev, "%s", rev);
+        get_str(&entry->head, "%s", head);
+        entry->stage = i;
+    }
+    fclose(f);
+}
+
+// write and rename so an interruption never leaves a torn journal.
+void journal_write(void) {
+
+    FILE *f;
+    register int i;
+
+    f = fopen(JOURNAL".tmp", "w");
+    if (f == NULL) {
+        printf(BRED"ERROR:"BOLD" Failed to write %s.\n"RESET, JOURNAL);
+        return;
+    }
+    for (i = 0; i < n_entries; i++) {
+        fprintf(f, "%s %s %s %s %s\n", entries[i].pkgname, stages[entries[i].stage], entries[i].pkgver, \
+                entries[i].rev, entries[i].head);
+    }
+    fflush(f);
+    fsync(fileno(f));
+    fclose(f);
+    rename(JOURNAL".tmp", JOURNAL);
+}
+
+Entry *find_entry(const char *pkgname) {
+
+    register int i;
+
+    for (i = 0; i < n_entries; i++) {
+        if (strcmp(entries[i].pkgname, pkgname) == 0) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+void free_entry(Entry *entry) {
+
+    free(entry->pkgname);
+    free(entry->pkgver);
+    free(entry->rev);
+    free(entry->head);
+}
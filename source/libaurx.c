@@ -0,0 +1,241 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "../include/aurx.h"
+#include "../include/memory.h"
+#include "../include/list.h"
+#include "../include/util.h"
+#include "../include/rpc.h"
+#include "../include/store.h"
+#include "../include/operation.h"
+
+#define PACMAN_LOCAL "/var/lib/pacman/local"
+#define PACMAN_SYNC "/var/lib/pacman/sync"
+
+// paths are built from dir, the working directory belongs to the host
+// program and other handles.
+struct aurx {
+    char *dir;
+    char *store_path;
+    List *installed;            // foreign packages, NULL when there are none
+    bool loaded;
+    struct timespec db_stamp;   // pacman databases the list was read from
+    Store *store;
+    ino_t store_ino;
+};
+
+List *warm_installed(Aurx *aurx);
+Store *warm_store(Aurx *aurx);
+void db_stamp(struct timespec *stamp);
+void init_result(Aurx_result *out, List *list);
+void add_result(Aurx_result *out, List *pkg, const char *new_version, bool installed);
+
+Aurx *aurx_open(const char *cache_dir) {
+
+    char *dir = NULL;
+    Aurx *aurx;
+
+    if (cache_dir != NULL) {
+        get_str(&dir, "%s", cache_dir);
+    } else {
+        get_str(&dir, "%s/.cache/aurx", getenv("HOME"));
+    }
+    if (is_dir(dir) == false) {
+        free(dir);
+        return NULL;
+    }
+
+    aurx = array_alloc(NULL, sizeof(Aurx));
+    aurx->dir = dir;
+    aurx->store_path = NULL;
+    get_str(&aurx->store_path, "%s/"STORE, dir);
+    aurx->installed = NULL;
+    aurx->loaded = false;
+    aurx->store = NULL;
+    aurx->store_ino = 0;
+
+    return aurx;
+}
+
+void aurx_close(Aurx *aurx) {
+
+    if (aurx == NULL) {
+        return;
+    }
+    clear_list(aurx->installed);
+    store_free(aurx->store);
+    free(aurx->store_path);
+    free(aurx->dir);
+    free(aurx);
+}
+
+int aurx_installed(Aurx *aurx, Aurx_result *out) {
+
+    List *installed, *pkg;
+
+    installed = warm_installed(aurx);
+    init_result(out, installed);
+    for (pkg = installed; pkg != NULL; pkg = pkg->next) {
+        add_result(out, pkg, NULL, true);
+    }
+
+    return 0;
+}
+
+int aurx_search(Aurx *aurx, const char *keyword, Aurx_result *out) {
+
+    char *str = NULL;
+    List *rpc_pkglist, *pkg;
+    Store *store;
+
+    out->pkgs = NULL;
+    out->n = 0;
+    if (is_dir(aurx->dir) == false) {
+        return -1;
+    }
+
+    store = warm_store(aurx);
+    if (store != NULL) {
+        rpc_pkglist = store_search(store, keyword);
+    } else {
+        get_str(&str, AUR_SEARCH, keyword);
+        rpc_pkglist = get_rpc_data(str);
+        free(str);
+    }
+
+    rpc_pkglist = mark_installed(rpc_pkglist, warm_installed(aurx));
+    init_result(out, rpc_pkglist);
+    for (pkg = rpc_pkglist; pkg != NULL; pkg = pkg->next) {
+        add_result(out, pkg, NULL, pkg->installed);
+    }
+    clear_list(rpc_pkglist);
+
+    return 0;
+}
+
+int aurx_updates(Aurx *aurx, Aurx_result *out) {
+
+    List *installed, *updates, *pkg;
+
+    out->pkgs = NULL;
+    out->n = 0;
+    installed = warm_installed(aurx);
+    if (installed == NULL) {
+        return 0;
+    }
+
+    if (is_dir(aurx->dir) == false) {
+        return -1;
+    }
+    // marks the outdated nodes of the warm list, reset on every check.
+    updates = get_updates(installed, warm_store(aurx), false);
+
+    init_result(out, updates);
+    for (pkg = updates; pkg != NULL; pkg = pkg->next) {
+        add_result(out, find_pkg(installed, pkg->pkgname), pkg->pkgver, true);
+    }
+    clear_list(updates);
+
+    return 0;
+}
+
+void aurx_result_free(Aurx_result *result) {
+
+    size_t i;
+
+    for (i = 0; i < result->n; i++) {
+        free(result->pkgs[i].name);
+        free(result->pkgs[i].version);
+        free(result->pkgs[i].new_version);
+    }
+    free(result->pkgs);
+    result->pkgs = NULL;
+    result->n = 0;
+}
+
+// alpm and the sync databases are only read again after pacman touched them.
+List *warm_installed(Aurx *aurx) {
+
+    struct timespec stamp;
+
+    db_stamp(&stamp);
+    if (aurx->loaded && stamp.tv_sec == aurx->db_stamp.tv_sec && \
+        stamp.tv_nsec == aurx->db_stamp.tv_nsec) {
+        return aurx->installed;
+    }
+
+    clear_list(aurx->installed);
+    aurx->installed = get_installed_list();
+    aurx->loaded = true;
+    aurx->db_stamp = stamp;
+
+    return aurx->installed;
+}
+
+// keep the mapping until "aurx -y" renames a new store over it or it goes stale.
+Store *warm_store(Aurx *aurx) {
+
+    struct stat st;
+
+    if (stat(aurx->store_path, &st) < 0 || time(NULL) - st.st_mtime > META_MAX_AGE) {
+        store_free(aurx->store);
+        aurx->store = NULL;
+        return NULL;
+    }
+    if (aurx->store != NULL && st.st_ino == aurx->store_ino) {
+        return aurx->store;
+    }
+
+    store_free(aurx->store);
+    aurx->store = store_open(aurx->dir);
+    aurx->store_ino = st.st_ino;
+
+    return aurx->store;
+}
+
+// latest change to the local or sync databases.
+void db_stamp(struct timespec *stamp) {
+
+    struct stat local, sync;
+
+    stamp->tv_sec = 0;
+    stamp->tv_nsec = 0;
+    if (stat(PACMAN_LOCAL, &local) == 0) {
+        *stamp = local.st_mtim;
+    }
+    if (stat(PACMAN_SYNC, &sync) == 0 && (sync.st_mtim.tv_sec > stamp->tv_sec || \
+        (sync.st_mtim.tv_sec == stamp->tv_sec && sync.st_mtim.tv_nsec > stamp->tv_nsec))) {
+        *stamp = sync.st_mtim;
+    }
+}
+
+// size the result for every node of list.
+void init_result(Aurx_result *out, List *list) {
+
+    size_t n;
+
+    for (n = 0; list != NULL; list = list->next) {
+        n++;
+    }
+    out->pkgs = n ? array_alloc(NULL, n * sizeof(Aurx_pkg)) : NULL;
+    out->n = 0;
+}
+
+void add_result(Aurx_result *out, List *pkg, const char *new_version, bool installed) {
+
+    Aurx_pkg *p;
+
+    p = &out->pkgs[out->n++];
+    p->name = NULL;
+    p->version = NULL;
+    p->new_version = NULL;
+    get_str(&p->name, "%s", pkg->pkgname);
+    get_str(&p->version, "%s", pkg->pkgver);
+    if (new_version != NULL) {
+        get_str(&p->new_version, "%s", new_version);
+    }
+    p->popularity = pkg->pop;
+    p->installed = installed;
+}
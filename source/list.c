@@ -44,6 +44,7 @@ List *get_installed_list(void) {
         if (pkg == NULL) {
             add_pkgname(aur, alpm_pkg_get_name(installed->data));
             add_pkgver(aur, alpm_pkg_get_name(installed->data), alpm_pkg_get_version(installed->data));
+            add_pkgbase(aur, alpm_pkg_get_name(installed->data), alpm_pkg_get_base(installed->data));
         }
     }
 
@@ -92,8 +93,27 @@ void add_pkgver(List *list, const char *pkgname, const char *pkgver) {
     strcpy(temp->pkgver, pkgver);
 }
 
+// split packages share the repo of their pkgbase.
+void add_pkgbase(List *list, const char *pkgname, const char *pkgbase) {
+
+    List *temp;
+
+    if (pkgbase == NULL || strcmp(pkgname, pkgbase) == 0) {
+        return;
+    }
+    temp = find_pkg(list, pkgname);
+    str_alloc(&temp->pkgbase, strlen(pkgbase) + 1);
+    strcpy(temp->pkgbase, pkgbase);
+}
+
+// the name of the repo (and cache dir) a package is built from.
+const char *pkg_base(List *pkg) {
+
+    return (pkg->pkgbase != NULL) ? pkg->pkgbase : pkg->pkgname;
+}
+
 // Store data retrieved from json in rpc.c
-List *add_json_data(List *list, const char *pkgname, const char *pkgver, int pop) {
+List *add_json_data(List *list, const char *pkgname, const char *pkgver, const char *pkgbase, int pop) {
 
     List *temp;
 
@@ -124,6 +144,10 @@ List *add_json_data(List *list, const char *pkgname, const char *pkgver, int pop
     strcpy(temp->pkgname, pkgname);
     str_alloc(&temp->pkgver, strlen(pkgver) + 1);
     strcpy(temp->pkgver, pkgver);
+    if (pkgbase != NULL && strcmp(pkgname, pkgbase) != 0) {
+        str_alloc(&temp->pkgbase, strlen(pkgbase) + 1);
+        strcpy(temp->pkgbase, pkgbase);
+    }
     temp->pop = pop;
 
     return list;
@@ -145,23 +169,79 @@ List *find_pkg(List *list, const char *pkgname) {
     }
 }
 
+// first package of the list built from pkgbase.
+List *find_base(List *list, const char *pkgbase) {
+
+    for (; list != NULL && list->pkgname != NULL; list = list->next) {
+        if (strcmp(pkg_base(list), pkgbase) == 0) {
+            return list;
+        }
+    }
+
+    return NULL;
+}
+
+// one node per pkgbase, named after it and carrying the version of the
+// first of its packages, so each repo is fetched and built once.
+List *get_bases(List *list) {
+
+    List *bases;
+
+    bases = list_malloc();
+    for (; list != NULL; list = list->next) {
+        if (find_base(bases, pkg_base(list)) == NULL) {
+            bases = add_pkgname(bases, pkg_base(list));
+            if (list->pkgver != NULL) {
+                add_pkgver(bases, pkg_base(list), list->pkgver);
+            }
+        }
+    }
+
+    if (bases->pkgname == NULL) {
+        clear_list(bases);
+        return NULL;
+    }
+    return bases;
+}
+
+// append the packages of list built from pkgbase to names, skipping
+// those already there.
+List *split_names(List *list, const char *pkgbase, List *names) {
+
+    for (; list != NULL; list = list->next) {
+        if (strcmp(pkg_base(list), pkgbase) == 0 && \
+            (names->pkgname == NULL || find_pkg(names, list->pkgname) == NULL)) {
+            names = add_pkgname(names, list->pkgname);
+        }
+    }
+
+    return names;
+}
+
 // check whether items on a list is installed.
 // (for search output)
 List *check_status(List *list) {
 
-    List *pkglist, *temp_list, *temp_pkglist;
+    List *pkglist;
 
     pkglist = get_installed_list();
-    temp_pkglist = pkglist;
+    list = mark_installed(list, pkglist);
+    clear_list(pkglist);
+
+    return list;
+}
+
+List *mark_installed(List *list, List *pkglist) {
+
+    List *temp_list, *temp_pkglist;
 
     for (temp_list = list; list != NULL; list = list->next) {
-        for (pkglist = temp_pkglist; pkglist != NULL; pkglist = pkglist->next) {
-            if (strcmp(list->pkgname, pkglist->pkgname) == 0) {
+        for (temp_pkglist = pkglist; temp_pkglist != NULL; temp_pkglist = temp_pkglist->next) {
+            if (strcmp(list->pkgname, temp_pkglist->pkgname) == 0) {
                 list->installed = true;
             }
         }
     }
-    clear_list(temp_pkglist);
 
     return temp_list;
 }
\ No newline at end of file
@@ -0,0 +1,72 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+#include "../include/lock.h"
+#include "../include/memory.h"
+#include "../include/util.h"
+
+// take a shared or exclusive lock on path, waiting for whoever holds a
+// conflicting one. returns the descriptor to unlock(), -1 if the lock
+// file can't be created (aurx then carries on unlocked).
+int lock_file(const char *path, bool exclusive) {
+
+    char dir[MAX_BUFFER], *slash;
+    int fd, op;
+
+    // the lock dir is next to path, libaurx passes absolute ones.
+    snprintf(dir, MAX_BUFFER, "%s", path);
+    slash = strrchr(dir, '/');
+    if (slash != NULL) {
+        *slash = '\0';
+        mkdir(dir, 0755);
+    }
+    fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        printf(BYELLOW"WARNING:"BOLD" Failed to open lock %s.\n"RESET, path);
+        return -1;
+    }
+
+    op = exclusive ? LOCK_EX : LOCK_SH;
+    if (flock(fd, op | LOCK_NB) == 0) {
+        return fd;
+    }
+    if (errno == EWOULDBLOCK) {
+        printf(BBLUE"=>"BOLD" Waiting for another aurx process (%s)...\n"RESET, path);
+        fflush(stdout);
+    }
+    while (flock(fd, op) < 0) {
+        if (errno != EINTR) {
+            close(fd);
+            return -1;
+        }
+    }
+
+    return fd;
+}
+
+// exclusive lock on one cache entry (clone, review, build, removal).
+int lock_pkg(const char *pkgname) {
+
+    char *path = NULL;
+    int fd;
+
+    str_alloc(&path, strlen(LOCK_DIR) + strlen(pkgname) + 7);
+    sprintf(path, LOCK_DIR"/%s.lock", pkgname);
+    fd = lock_file(path, true);
+    free(path);
+
+    return fd;
+}
+
+void unlock(int fd) {
+
+    if (fd >= 0) {
+        close(fd);
+    }
+}
@@ -1,10 +1,27 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 
+#define MEMORY_INTERNAL
 #include "../include/memory.h"
 #include "../include/list.h"
 #include "../include/rpc.h"
 #include "../include/util.h"
+#include "../include/store.h"
+
+#ifdef MEMSTAT
+#include <string.h>
+#include <malloc.h>
+#include <pthread.h>
+
+void *mem_realloc(void *ptr, size_t size);
+void mem_track(void *new);
+#define release(ptr) mem_free(ptr, NULL, 0)
+#else
+#define mem_realloc(ptr, size) realloc(ptr, size)
+#define mem_track(new)
+#define release(ptr) free(ptr)
+#endif
 
 void str_alloc(char **ptr, int size) {
 	
@@ -16,10 +33,11 @@ void str_alloc(char **ptr, int size) {
 		} else {
 				*ptr[0] = '\0';
 		}
+		mem_track(*ptr);
 	} else {
 		char *temp;
 
-		temp = realloc(*ptr, size);
+		temp = mem_realloc(*ptr, size);
 		if (temp == NULL) {
 			printf(BRED"ERROR:"BOLD" \e[0;1mFailed to reallocate memory of string.\n"RESET);
 			exit(EXIT_FAILURE);
@@ -28,6 +46,20 @@ void str_alloc(char **ptr, int size) {
 	}
 }
 
+// realloc wrapper for plain arrays (store columns etc.), ptr may be NULL.
+void *array_alloc(void *ptr, size_t size) {
+
+	void *temp;
+
+	temp = mem_realloc(ptr, size);
+	if (temp == NULL) {
+		printf(BRED"ERROR:"BOLD" Failed to allocate memory for array.\n"RESET);
+		exit(EXIT_FAILURE);
+	}
+
+	return temp;
+}
+
 List *list_malloc(void) {
 
 	List *temp = malloc(sizeof(List));
@@ -35,9 +67,11 @@ List *list_malloc(void) {
 		printf(BRED"ERROR:"BOLD" Failed to allocate memory for new node.\n"RESET);
 		exit(EXIT_FAILURE);
 	}
+	mem_track(temp);
 
 	temp->pkgname = NULL;
 	temp->pkgver = NULL;
+	temp->pkgbase = NULL;
 	temp->pop = 0;
 	temp->installed = false;
 	temp->update = false;
@@ -53,9 +87,10 @@ void clear_list(List *list) {
     while (list != NULL) {
         temp = list;
         list = list->next;
-        free(temp->pkgname);
-        free(temp->pkgver);
-        free(temp);
+        release(temp->pkgname);
+        release(temp->pkgver);
+        release(temp->pkgbase);
+        release(temp);
     }
 }
 
@@ -66,10 +101,275 @@ Json_buffer *json_buffer_malloc(void) {
 		printf(BRED"ERROR:"BOLD" Failed to allocate memory for JSON buffer.\n"RESET);
 		exit(EXIT_FAILURE);
 	}
+	mem_track(temp);
 	temp->response = NULL;
     str_alloc(&temp->response, sizeof(char *));
     temp->response[0] = '\0';
     temp->size = 0;
 
 	return temp;
-}
\ No newline at end of file
+}
+
+Store *store_malloc(void) {
+
+	Store *temp = malloc(sizeof(Store));
+	if (temp == NULL) {
+		printf(BRED"ERROR:"BOLD" Failed to allocate memory for package store.\n"RESET);
+		exit(EXIT_FAILURE);
+	}
+	mem_track(temp);
+	temp->map = NULL;
+	temp->map_size = 0;
+	temp->n = 0;
+	temp->name = NULL;
+	temp->ver = NULL;
+	temp->base = NULL;
+	temp->pop = NULL;
+	temp->index = NULL;
+	temp->blob = NULL;
+
+	return temp;
+}
+
+#ifdef MEMSTAT
+// Optional allocation accounting, built with -DMEMSTAT (make memstat).
+// Every allocation made through this file is remembered with the call
+// site that asked for it, memory.h routes free() here so live and peak
+// bytes can be attributed. The report is written on exit, appended to
+// $AURX_MEMSTAT when set so runs of different operations add up.
+
+#define MAX_SITES 1024
+
+typedef struct site {
+	const char *file;
+	int line;
+	long allocs;
+	long reallocs;
+	long frees;
+	long long live;
+	long long peak;
+} Site;
+
+typedef struct block {
+	uintptr_t ptr;		// 0 empty, 1 deleted
+	size_t size;
+	int site;
+} Block;
+
+static pthread_mutex_t mem_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread const char *cur_file;
+static __thread int cur_line;
+static const char *mem_op_name = "none";
+static Site sites[MAX_SITES];
+static int n_sites;
+static Block *blocks;
+static size_t blocks_cap, blocks_used;
+static Mem_stat total;
+
+void track(uintptr_t old, void *new);
+int get_site(const char *file, int line);
+Block *find_block(uintptr_t ptr, bool insert);
+void mem_report(void);
+
+void mem_site(const char *file, int line) {
+
+	cur_file = file;
+	cur_line = line;
+}
+
+void mem_op(const char *op) {
+
+	mem_op_name = op;
+	atexit(mem_report);
+}
+
+Mem_stat mem_stat(void) {
+
+	Mem_stat temp;
+
+	pthread_mutex_lock(&mem_lock);
+	temp = total;
+	pthread_mutex_unlock(&mem_lock);
+
+	return temp;
+}
+
+void mem_track(void *new) {
+
+	pthread_mutex_lock(&mem_lock);
+	track(0, new);
+	pthread_mutex_unlock(&mem_lock);
+}
+
+// realloc() releases the old block, and another thread could be handed its
+// address by malloc() before the entry is moved. both happen under mem_lock.
+void *mem_realloc(void *ptr, size_t size) {
+
+	void *temp;
+
+	pthread_mutex_lock(&mem_lock);
+	temp = realloc(ptr, size);
+	if (temp != NULL) {
+		track((uintptr_t)ptr, temp);
+	}
+	pthread_mutex_unlock(&mem_lock);
+
+	return temp;
+}
+
+// the caller holds mem_lock.
+void track(uintptr_t old, void *new) {
+
+	Block *block;
+	Site *site;
+	size_t size;
+
+	size = malloc_usable_size(new);
+	site = &sites[get_site(cur_file, cur_line)];
+	if (old == 0) {
+		site->allocs++;
+		total.allocs++;
+	} else {
+		site->reallocs++;
+		total.reallocs++;
+		block = find_block(old, false);
+		if (block != NULL) {
+			sites[block->site].live -= block->size;
+			total.live -= block->size;
+			block->ptr = 1;
+		}
+	}
+
+	block = find_block((uintptr_t)new, true);
+	block->size = size;
+	block->site = site - sites;
+	site->live += size;
+	if (site->live > site->peak) {
+		site->peak = site->live;
+	}
+	total.live += size;
+	if (total.live > total.peak) {
+		total.peak = total.live;
+	}
+}
+
+// file is NULL when called from within this file, the caller's site is then
+// the one set by the memory.h wrapper.
+void mem_free(void *ptr, const char *file, int line) {
+
+	Block *block;
+
+	if (ptr == NULL) {
+		return;
+	}
+
+	// memory from libc or json-c is passed through without being counted.
+	pthread_mutex_lock(&mem_lock);
+	block = find_block((uintptr_t)ptr, false);
+	if (block != NULL) {
+		sites[get_site(file ? file : cur_file, file ? line : cur_line)].frees++;
+		total.frees++;
+		sites[block->site].live -= block->size;
+		total.live -= block->size;
+		block->ptr = 1;
+	}
+	pthread_mutex_unlock(&mem_lock);
+
+	free(ptr);
+}
+
+int get_site(const char *file, int line) {
+
+	register int i;
+
+	if (file == NULL) {
+		file = "?";
+	}
+	for (i = 0; i < n_sites; i++) {
+		if (sites[i].line == line && strcmp(sites[i].file, file) == 0) {
+			return i;
+		}
+	}
+	if (n_sites == MAX_SITES) {
+		return MAX_SITES - 1;
+	}
+	sites[n_sites].file = file;
+	sites[n_sites].line = line;
+
+	return n_sites++;
+}
+
+// open addressing on the pointer value, grown (and purged of deleted
+// entries) with plain calloc so the table never counts itself.
+Block *find_block(uintptr_t ptr, bool insert) {
+
+	Block *old, *reuse = NULL;
+	size_t i, old_cap;
+	uint64_t hash;
+
+	if (insert && (blocks_used + 1) * 2 > blocks_cap) {
+		old = blocks;
+		old_cap = blocks_cap;
+		blocks_cap = old_cap ? old_cap * 2 : 4096;
+		blocks = calloc(blocks_cap, sizeof(Block));
+		if (blocks == NULL) {
+			printf(BRED"ERROR:"BOLD" Failed to allocate memory for allocation table.\n"RESET);
+			exit(EXIT_FAILURE);
+		}
+		blocks_used = 0;
+		for (i = 0; i < old_cap; i++) {
+			if (old[i].ptr > 1) {
+				*find_block(old[i].ptr, true) = old[i];
+			}
+		}
+		free(old);
+	}
+	if (blocks_cap == 0) {
+		return NULL;
+	}
+
+	// malloc hands out neighbouring addresses, scramble them before probing.
+	hash = (uint64_t)(ptr >> 4) * 0x9E3779B97F4A7C15ULL;
+	for (i = (hash ^ (hash >> 32)) & (blocks_cap - 1); blocks[i].ptr != 0; i = (i + 1) & (blocks_cap - 1)) {
+		if (blocks[i].ptr == ptr) {
+			return &blocks[i];
+		} else if (blocks[i].ptr == 1 && reuse == NULL) {
+			reuse = &blocks[i];
+		}
+	}
+	if (insert == false) {
+		return NULL;
+	}
+
+	if (reuse == NULL) {
+		reuse = &blocks[i];
+		blocks_used++;
+	}
+	reuse->ptr = ptr;
+	return reuse;
+}
+
+void mem_report(void) {
+
+	FILE *f = stderr;
+	char *path;
+	register int i;
+
+	path = getenv("AURX_MEMSTAT");
+	if (path != NULL && (f = fopen(path, "a")) == NULL) {
+		f = stderr;
+	}
+
+	fprintf(f, "== memstat %s: %ld allocs, %ld reallocs, %ld frees, %lld bytes live, %lld bytes peak\n", \
+			mem_op_name, total.allocs, total.reallocs, total.frees, total.live, total.peak);
+	fprintf(f, "%-28s %10s %10s %10s %12s %12s\n", "site", "allocs", "reallocs", "frees", "live", "peak");
+	for (i = 0; i < n_sites; i++) {
+		fprintf(f, "%-22s:%-5d %10ld %10ld %10ld %12lld %12lld\n", sites[i].file, sites[i].line, \
+				sites[i].allocs, sites[i].reallocs, sites[i].frees, sites[i].live, sites[i].peak);
+	}
+
+	if (f != stderr) {
+		fclose(f);
+	}
+}
+#endif
\ No newline at end of file
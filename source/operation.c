@@ -7,17 +7,45 @@
 #include "../include/util.h"
 #include "../include/list.h"
 #include "../include/rpc.h"
-
-bool epoch_update(List *pkg, char *pkgver);
-void install(const char *pkgname);
+#include "../include/store.h"
+#include "../include/srcinfo.h"
+#include "../include/vcs.h"
+#include "../include/srcdest.h"
+#include "../include/journal.h"
+#include "../include/lock.h"
+#include "../include/cache.h"
+#include "../include/ccache.h"
+#include "../include/chroot.h"
+
+typedef struct check {
+	List **pkgs;			// installed packages, in order
+	char **aur_pkgver;		// NULL until checked, or when not on the AUR
+	bool *done;
+	int n;
+	int next;				// first package not yet reported
+	bool print;
+	List *updates;
+} Check;
+
+void install(const char *pkgbase, List *pkgnames);
+bool install_split(const char *pkgbase, List *pkgnames);
+char *split_pkgname(const char *path);
+void set_pkgbase(List *list);
+void add_pkgbase_cb(int i, List *rpc_pkg, void *arg);
+List *get_names(List *wanted, List *installed, const char *pkgbase);
 void check_update(List *pkglist);
-void fetch_update(char *pkgname);
-void less_prompt(const char *pkgname);
+bool resume(void);
+void add_update(int i, List *rpc_pkg, void *arg);
+void flush_updates(Check *check);
+void less_prompt(const char *pkgbase, List *pkgnames);
+void review(const char *pkgbase, List *pkgnames);
+void pull(const char *pkgname, const char *pkgver);
+bool valid_pkgname(const char *name);
 
 void target_clone(char *url) {
 
-    char *str = NULL, pkgname[NAME_LEN] = {'\0'}, *temp;
-    register int i;
+    char *str = NULL, pkgname[NAME_LEN] = {'\0'}, *temp, *pkgbase, *version;
+    register int i, fd;
 
 	temp = url;
 	while (*temp != '\0') {
@@ -32,6 +60,7 @@ void target_clone(char *url) {
         pkgname[i] = *temp++;
     }
 
+	fd = lock_pkg(pkgname);
 	if (is_dir(pkgname) == true) {
 		printf("Removing %s directory before clone...\n", pkgname);
 		remove_dir(pkgname);
@@ -40,15 +69,125 @@ void target_clone(char *url) {
 	get_str(&str, GIT_CLONE, url);
     system(str);
     free(str);
-	
-	less_prompt(pkgname);
+	unlock(fd);
+
+	// the url says nothing about the package, its .SRCINFO does. the repo
+	// is kept under its pkgbase like any other clone.
+	pkgbase = srcinfo_first(pkgname, "pkgbase");
+	if (pkgbase != NULL && strcmp(pkgbase, pkgname) != 0 && valid_pkgname(pkgbase) == true) {
+		fd = lock_pkg(pkgbase);
+		if (is_dir(pkgbase) == false && rename(pkgname, pkgbase) == 0) {
+			snprintf(pkgname, NAME_LEN, "%s", pkgbase);
+		}
+		unlock(fd);
+	}
+	free(pkgbase);
+
+	version = srcinfo_version(pkgname);
+	if (version != NULL) {
+		printf(BBLUE"=>"BOLD" %s %s\n"RESET, pkgname, version);
+		free(version);
+	}
+
+	less_prompt(pkgname, NULL);
 }
 
 
+// clone every repo first so their sources download together. split
+// packages are cloned, reviewed and built once per pkgbase.
+void aur_install(List *list) {
+
+	List *bases, *installed, *names, *temp;
+
+	set_pkgbase(list);
+	bases = get_bases(list);
+	for (temp = bases; temp != NULL; temp = temp->next) {
+		aur_clone(temp->pkgname);
+	}
+	source_prefetch(bases);
+
+	// installed packages of the same pkgbase are rebuilt with the new ones
+	// and have to be upgraded alongside them.
+	installed = get_installed_list();
+	for (temp = bases; temp != NULL; temp = temp->next) {
+		names = get_names(list, installed, temp->pkgname);
+		less_prompt(temp->pkgname, names);
+		clear_list(names);
+	}
+	clear_list(installed);
+	clear_list(bases);
+}
+
+// look up the pkgbase of packages named on the command line, from the
+// store when it is fresh and the RPC otherwise.
+void set_pkgbase(List *list) {
+
+	char **urls;
+	register int i, n, row;
+	List *temp, **pkgs;
+	Store *store;
+
+	store = store_load();
+	if (store != NULL) {
+		for (temp = list; temp != NULL; temp = temp->next) {
+			row = store_find(store, temp->pkgname);
+			if (row >= 0) {
+				add_pkgbase(list, temp->pkgname, store_pkgbase(store, row));
+			}
+		}
+		store_free(store);
+		return;
+	}
+
+	for (n = 0, temp = list; temp != NULL; temp = temp->next) {
+		n++;
+	}
+	urls = array_alloc(NULL, (n + 1) * sizeof(char *));
+	pkgs = array_alloc(NULL, (n + 1) * sizeof(List *));
+	for (i = 0, temp = list; temp != NULL; i++, temp = temp->next) {
+		pkgs[i] = temp;
+		urls[i] = NULL;
+		get_str(&urls[i], AUR_PKG, temp->pkgname);
+	}
+	get_rpc_multi(urls, n, add_pkgbase_cb, pkgs);
+	for (i = 0; i < n; i++) {
+		free(urls[i]);
+	}
+	free(urls);
+	free(pkgs);
+}
+
+void add_pkgbase_cb(int i, List *rpc_pkg, void *arg) {
+
+	List **pkgs = arg;
+
+	if (rpc_pkg != NULL) {
+		add_pkgbase(pkgs[i], pkgs[i]->pkgname, rpc_pkg->pkgbase);
+	}
+	clear_list(rpc_pkg);
+}
+
+// the packages of pkgbase to install: those asked for plus those already
+// installed. NULL when there are none, install() then takes everything.
+List *get_names(List *wanted, List *installed, const char *pkgbase) {
+
+	List *names;
+
+	names = split_names(wanted, pkgbase, list_malloc());
+	names = split_names(installed, pkgbase, names);
+	if (names->pkgname == NULL) {
+		clear_list(names);
+		return NULL;
+	}
+	return names;
+}
+
 void aur_clone(char *pkgname) {
 
     char *str = NULL;
+    int fd;
 
+	fd = lock_pkg(pkgname);
 	if (is_dir(pkgname) == true) {
 		printf("Removing %s directory before clone...\n", pkgname);
 		remove_dir(pkgname);
@@ -57,98 +196,323 @@ void aur_clone(char *pkgname) {
 	get_str(&str, AUR_CLONE, pkgname); 
 	system(str);
 	free(str);
-   
-	less_prompt(pkgname);   
+	unlock(fd);
 }
 
 void update(void) {
 	
-	char c, *str = NULL, *update_list = NULL;
-	register int i;
-	List *pkglist, *rpc_pkg, *temp;
-
-	str_alloc(&update_list, sizeof(char)); 	// must malloc here in order to realloc later on with strlen(update_list)
+	List *pkglist, *updates;
+	Store *store;
+	int fd;
+
+	// one -u at a time, the journal describes a single run.
+	fd = lock_file(JOURNAL_LOCK, true);
+	if (resume() == true) {
+		unlock(fd);
+		return;
+	}
 
 	pkglist = get_installed_list();
 	if (pkglist == NULL) {
 		printf("No installed AUR packages found.\n");
 	}
 
+	// a fresh metadata store answers every lookup locally.
+	store = store_load();
 	printf(BBLUE"::"BOLD" Looking for updates...\n"RESET);
-	for (temp = pkglist; pkglist != NULL; pkglist = pkglist->next) {
-		
-		get_str(&str, AUR_PKG , pkglist->pkgname);
-		rpc_pkg = get_rpc_data(str);
-
-		if (strcmp(pkglist->pkgver, rpc_pkg->pkgver) < 0 || epoch_update(pkglist, rpc_pkg->pkgver)) { 
-			pkglist->update = true;
-			str_alloc(&str, (strlen(pkglist->pkgname) + strlen(pkglist->pkgver) + strlen(rpc_pkg->pkgver) + 69));
-			sprintf(str, " %-30s"GREY"%-20s"RESET"-> "BGREEN"%s\n"RESET, pkglist->pkgname, pkglist->pkgver, rpc_pkg->pkgver);
-			str_alloc(&update_list, (strlen(update_list) + strlen(str) + 1));
-			strcat(update_list, str);
-		}
-		clear_list(rpc_pkg);
-	}
-	free(str);
+	updates = get_updates(pkglist, store, true);
+	clear_list(pkglist);
+	store_free(store);
 
-	pkglist = temp;
-	if (update_list[0] == '\0') {
+	if (updates == NULL) {
 		printf(" Nothing to do.\n");
-		free(update_list);
-		clear_list(pkglist);
 		exit(EXIT_SUCCESS);
-	} else {
-		printf(BBLUE"::"BOLD" Updates are available for:"RESET"\n\n%s\n", update_list);
-		free(update_list);
+	}
+	printf("\n");
+
+	install_updates(updates);
+	clear_list(updates);
+	unlock(fd);
+
+	// keeps the cache bounded without pruning, the clones stay warm for the next -u.
+	cache_trim(false);
+}
+
+// offer to finish an update run that was interrupted, skipping the checks
+// and whatever fetches, reviews and builds already completed.
+bool resume(void) {
+
+	List *pending, *temp;
+
+	pending = journal_pending();
+	if (pending == NULL) {
+		return false;
+	}
+
+	printf(BBLUE"::"BOLD" An interrupted update was found for:"RESET"\n\n");
+	for (temp = pending; temp != NULL; temp = temp->next) {
+		printf(" %-30s"BGREEN"%s\n"RESET, temp->pkgname, temp->pkgver);
+	}
+	printf("\n"BBLUE"::"BOLD" Resume it? [Y/n] "RESET);
+	if (prompt() == false) {
+		journal_end();
+		clear_list(pending);
+		return false;
 	}
 
+	run_updates(pending);
+	clear_list(pending);
+	return true;
+}
+
+// ask once, fetch every repo, then review and build them one by one.
+void install_updates(List *updates) {
+
 	printf(BBLUE"::"BOLD" Proceed with installation? [Y/n] "RESET);
 	if (prompt() == false) {
-		clear_list(pkglist);
 		return;
 	}
-	
-	check_update(pkglist);
-	for (temp = pkglist; pkglist != NULL; pkglist = pkglist->next) {
-		if (pkglist->update == true) {
-			less_prompt(pkglist->pkgname);
+	run_updates(updates);
+}
+
+// work is done per pkgbase, the journal and the cache dirs are keyed by it.
+void run_updates(List *updates) {
+
+	List *bases, *installed, *names, *temp, *pending;
+
+	bases = get_bases(updates);
+	journal_begin(bases);
+	check_update(bases);
+	source_prefetch(bases);
+
+	installed = get_installed_list();
+	for (temp = bases; temp != NULL; temp = temp->next) {
+		names = get_names(NULL, installed, temp->pkgname);
+		less_prompt(temp->pkgname, names);
+		clear_list(names);
+	}
+	clear_list(installed);
+	clear_list(bases);
+
+	// failed builds stay in the journal for the next -u, declined ones
+	// were removed by review().
+	pending = journal_pending();
+	if (pending == NULL) {
+		journal_end();
+	}
+	clear_list(pending);
+}
+
+// non-interactive half of -u: refresh metadata and pull the outdated repos
+// so a later -u only has to review and build.
+void prefetch(void) {
+
+	List *pkglist, *updates, *bases;
+	Store *store;
+
+	printf(BBLUE"::"BOLD" Refreshing AUR metadata...\n"RESET);
+	fetch_meta();
+
+	pkglist = get_installed_list();
+	if (pkglist == NULL) {
+		printf("No installed AUR packages found.\n");
+		return;
+	}
+
+	store = store_load();
+	printf(BBLUE"::"BOLD" Looking for updates...\n"RESET);
+	updates = get_updates(pkglist, store, false);
+	clear_list(pkglist);
+	store_free(store);
+	if (updates == NULL) {
+		printf(" Nothing to do.\n");
+		return;
+	}
+
+	bases = get_bases(updates);
+	check_update(bases);
+	source_prefetch(bases);
+	clear_list(bases);
+	clear_list(updates);
+}
+
+// compare installed versions against the AUR, using the store when given
+// and the RPC otherwise. returns the outdated packages with their new
+// version as pkgver, in installed (alphabetical) order. with print set each
+// one is shown as soon as it and every package before it has been checked.
+// the update flag of every node of pkglist is set to the result.
+List *get_updates(List *pkglist, Store *store, bool print) {
+
+	char **urls;
+	register int i, row;
+	List *temp;
+	Check check;
+
+	for (check.n = 0, temp = pkglist; temp != NULL; temp = temp->next) {
+		check.n++;
+	}
+	check.pkgs = array_alloc(NULL, (check.n + 1) * sizeof(List *));
+	check.aur_pkgver = array_alloc(NULL, (check.n + 1) * sizeof(char *));
+	check.done = array_alloc(NULL, (check.n + 1) * sizeof(bool));
+	for (i = 0, temp = pkglist; temp != NULL; i++, temp = temp->next) {
+		check.pkgs[i] = temp;
+		check.pkgs[i]->update = false;		// pkglist may be reused, see libaurx.c
+		check.aur_pkgver[i] = NULL;
+		check.done[i] = false;
+	}
+	check.next = 0;
+	check.print = print;
+	check.updates = list_malloc();
+
+	// the RPC is asked several packages at a time.
+	if (store != NULL) {
+		for (i = 0; i < check.n; i++) {
+			row = store_find(store, check.pkgs[i]->pkgname);
+			if (row >= 0) {
+				get_str(&check.aur_pkgver[i], "%s", store_pkgver(store, row));
+			}
+			check.done[i] = true;
+			flush_updates(&check);
+		}
+	} else {
+		urls = array_alloc(NULL, (check.n + 1) * sizeof(char *));
+		for (i = 0; i < check.n; i++) {
+			urls[i] = NULL;
+			get_str(&urls[i], AUR_PKG, check.pkgs[i]->pkgname);
+		}
+		get_rpc_multi(urls, check.n, add_update, &check);
+		for (i = 0; i < check.n; i++) {
+			free(urls[i]);
 		}
+		free(urls);
 	}
-	clear_list(temp);
+
+	for (i = 0; i < check.n; i++) {
+		free(check.aur_pkgver[i]);
+	}
+	free(check.pkgs);
+	free(check.aur_pkgver);
+	free(check.done);
+
+	if (check.updates->pkgname == NULL) {
+		clear_list(check.updates);
+		return NULL;
+	}
+	return check.updates;
 }
 
-void check_update(List *pkglist) {
+// RPC callback, results land in any order.
+void add_update(int i, List *rpc_pkg, void *arg) {
+
+	Check *check = arg;
 
-	while (pkglist != NULL) {
-		if (pkglist->update == true) {
-			fetch_update(pkglist->pkgname);
+	if (rpc_pkg != NULL) {
+		get_str(&check->aur_pkgver[i], "%s", rpc_pkg->pkgver);
+	}
+	clear_list(rpc_pkg);
+	check->done[i] = true;
+	flush_updates(check);
+}
+
+// emit the checked prefix of the installed list.
+void flush_updates(Check *check) {
+
+	List *pkg;
+	const char *aur_pkgver;
+
+	for (; check->next < check->n && check->done[check->next]; check->next++) {
+		pkg = check->pkgs[check->next];
+		aur_pkgver = check->aur_pkgver[check->next];
+		if (aur_pkgver == NULL || (strcmp(pkg->pkgver, aur_pkgver) >= 0 && !epoch_update(pkg, aur_pkgver))) {
+			continue;
+		}
+
+		pkg->update = true;
+		if (check->print) {
+			if (check->updates->pkgname == NULL) {
+				printf(BBLUE"::"BOLD" Updates are available for:"RESET"\n\n");
+			}
+			printf(" %-30s"GREY"%-20s"RESET"-> "BGREEN"%s\n"RESET, pkg->pkgname, pkg->pkgver, aur_pkgver);
+			fflush(stdout);
 		}
-		pkglist = pkglist->next;
+		check->updates = add_pkgname(check->updates, pkg->pkgname);
+		add_pkgver(check->updates, pkg->pkgname, aur_pkgver);
+		add_pkgbase(check->updates, pkg->pkgname, pkg->pkgbase);
 	}
 }
 
-void force_update(char *pkgname) {
+// pkgver of each node is the version to fetch.
+void check_update(List *updates) {
 
-	List *pkglist, *pkg;
+	while (updates != NULL) {
+		fetch_update(updates->pkgname, updates->pkgver);
+		updates = updates->next;
+	}
+}
+
+// rebuild installed packages regardless of version, once per pkgbase.
+void force_update(List *list) {
+
+	List *pkglist, *pkg, *targets, *bases, *names, *temp;
 
 	pkglist = get_installed_list();
-	pkg = find_pkg(pkglist, pkgname);
-	
+	targets = list_malloc();
+	for (temp = list; temp != NULL; temp = temp->next) {
+		pkg = find_pkg(pkglist, temp->pkgname);
+		if (pkg == NULL) {
+			printf(BRED"ERROR:"BOLD" %s is not installed.\n"RESET, temp->pkgname);
+			exit(EXIT_FAILURE);
+		}
+		targets = add_pkgname(targets, pkg->pkgname);
+		add_pkgbase(targets, pkg->pkgname, pkg->pkgbase);
+	}
 
-	if (pkg == NULL) {
-		printf(BRED"ERROR:"BOLD" %s is not installed."RESET);
-		exit(EXIT_FAILURE);
+	bases = get_bases(targets);
+	for (temp = bases; temp != NULL; temp = temp->next) {
+		fetch_update(temp->pkgname, NULL);
+	}
+	source_prefetch(bases);
+	for (temp = bases; temp != NULL; temp = temp->next) {
+		names = get_names(NULL, pkglist, temp->pkgname);
+		less_prompt(temp->pkgname, names);
+		clear_list(names);
 	}
+	clear_list(bases);
+	clear_list(targets);
 	clear_list(pkglist);
-	
-	fetch_update(pkgname);
-	less_prompt(pkgname);
 }
 
-void fetch_update(char *pkgname) {
+// pkgver is the version being updated to, when the cached repo already
+// holds it (fetched by -p) the network round trip is skipped.
+void fetch_update(const char *pkgname, const char *pkgver) {
+
+	int fd;
+
+	fd = lock_pkg(pkgname);
+	pull(pkgname, pkgver);
+	unlock(fd);
+}
+
+void pull(const char *pkgname, const char *pkgver) {
 
 	char *str = NULL;
 
+	if (journal_stage(pkgname) >= FETCHED) {
+		printf(BBLUE"=>"BOLD" %s already fetched.\n"RESET, pkgname);
+		return;
+	}
+	if (pkgver != NULL && is_dir(pkgname) == true) {
+		str = srcinfo_version(pkgname);
+		if (str != NULL && strcmp(str, pkgver) == 0) {
+			printf(BBLUE"=>"BOLD" %s %s already fetched.\n"RESET, pkgname, pkgver);
+			journal_set(pkgname, FETCHED);
+			free(str);
+			return;
+		}
+		free(str);
+		str = NULL;
+	}
+
 	printf(BBLUE"=>"BOLD" Fetching update for %s...\n"RESET, pkgname);
 	if (is_dir(pkgname) == false) {
 		get_str(&str, AUR_CLONE_NULL, pkgname);
@@ -156,100 +520,237 @@ void fetch_update(char *pkgname) {
 		get_str(&str, GIT_PULL_NULL, pkgname);
 	}
 
-	system(str);
+	if (system(str) == 0) {
+		journal_set(pkgname, FETCHED);
+	}
 	free(str);
 }
 
-void less_prompt(const char *pkgname) {
+// review and build hold the package lock so nothing pulls or removes the
+// repo in between.
+void less_prompt(const char *pkgbase, List *pkgnames) {
+
+	int fd;
+
+	fd = lock_pkg(pkgbase);
+	review(pkgbase, pkgnames);
+	unlock(fd);
+}
+
+void review(const char *pkgbase, List *pkgnames) {
 
 	char c, *str = NULL;
 	register int i;
 
-	get_str(&str, "%s/PKGBUILD", pkgname);
+	get_str(&str, "%s/PKGBUILD", pkgbase);
 	if (file_exists(str) != true) {
-		printf(BRED"ERROR:"BOLD" PKGBUILD for %s not found\n"RESET, pkgname);
+		printf(BRED"ERROR:"BOLD" PKGBUILD for %s not found\n"RESET, pkgbase);
 		free(str);
 		return;
 	}
 
-    printf(BBLUE"::"BOLD" View %s PKGBUILD in less? [Y/n] "RESET, pkgname);
+	if (journal_stage(pkgbase) >= REVIEWED) {
+		free(str);
+		install(pkgbase, pkgnames);
+		return;
+	}
+
+    printf(BBLUE"::"BOLD" View %s PKGBUILD in less? [Y/n] "RESET, pkgbase);
 
 	if (prompt() == false) {
 		free(str);
-		install(pkgname);
+		journal_set(pkgbase, REVIEWED);
+		install(pkgbase, pkgnames);
 		return;
 	}
 	
-	get_str(&str, LESS_PKGBUILD, pkgname);
+	get_str(&str, LESS_PKGBUILD, pkgbase);
 	system(str);
 	free(str);
 
 	printf(BBLUE"::"BOLD" Continue to install? [Y/n] "RESET);
 	if (prompt() == true) {
-		install(pkgname);
-	}	
+		journal_set(pkgbase, REVIEWED);
+		install(pkgbase, pkgnames);
+	} else {
+		journal_remove(pkgbase);
+	}
 }
 
-void install(const char *pkgname) {
+// build and install are separate makepkg runs so a resumed -u can install
+// a package that was built before the interruption without rebuilding it.
+// with pkgnames only those packages of a split pkgbase are installed,
+// otherwise everything it builds.
+void install(const char *pkgbase, List *pkgnames) {
     
     char *str = NULL;
+    int res;
+    bool installed;
+
+    if (journal_stage(pkgbase) < BUILT) {
+        source_link(pkgbase);
+        if (chroot_enabled() == true) {
+            res = chroot_build(pkgbase) ? 0 : 1;
+        } else {
+            get_str(&str, MAKEPKG_BUILD, pkgbase);	// don't build -debug packages for now.
+            ccache_begin(pkgbase);
+            res = system(str);
+            ccache_end(pkgbase);
+        }
+        if (res != 0) {
+            free(str);
+            return;
+        }
+        journal_set(pkgbase, BUILT);
+    }
 
-    get_str(&str, MAKEPKG, pkgname);	// don't build -debug packages for now.
-    system(str);
+    if (pkgnames != NULL) {
+        installed = install_split(pkgbase, pkgnames);
+    } else {
+        get_str(&str, MAKEPKG_INSTALL, pkgbase);
+        installed = system(str) == 0;
+    }
+    if (installed == true) {
+        vcs_commit(pkgbase);
+        journal_set(pkgbase, INSTALLED);
+    }
+    free(str);
+}
+
+// pacman -U the built files of pkgnames, makepkg -i would install every
+// package of the pkgbase.
+bool install_split(const char *pkgbase, List *pkgnames) {
+
+    char *str = NULL, *cmd = NULL, *pkgname, line[MAX_BUFFER];
+    int n = 0, res;
+    FILE *p;
+
+    get_str(&str, MAKEPKG_LIST, pkgbase);
+    p = popen(str, "r");
     free(str);
+    if (p == NULL) {
+        printf(BRED"ERROR:"BOLD" Failed to list packages of %s.\n"RESET, pkgbase);
+        return false;
+    }
+
+    get_str(&cmd, PACMAN_INSTALL, pkgbase);
+    while (fgets(line, MAX_BUFFER, p) != NULL) {
+        line[strcspn(line, "\n")] = '\0';
+        pkgname = split_pkgname(line);
+        if (pkgname != NULL && find_pkg(pkgnames, pkgname) != NULL) {
+            str_alloc(&cmd, strlen(cmd) + strlen(line) + 4);
+            strcat(cmd, " '");
+            strcat(cmd, line);
+            strcat(cmd, "'");
+            n++;
+        }
+        free(pkgname);
+    }
+    pclose(p);
+
+    if (n == 0) {
+        printf(BRED"ERROR:"BOLD" No package to install was built by %s.\n"RESET, pkgbase);
+        free(cmd);
+        return false;
+    }
+
+    str_alloc(&cmd, strlen(cmd) + strlen(" && git clean -dfx") + 1);
+    strcat(cmd, " && git clean -dfx");
+    res = system(cmd);
+    free(cmd);
+
+    return res == 0;
+}
+
+// package file names are pkgname-pkgver-pkgrel-arch.pkg.tar.*, and none of
+// the last three may contain a dash.
+char *split_pkgname(const char *path) {
+
+    const char *file, *end;
+    char *pkgname = NULL;
+    register int i;
+
+    file = strrchr(path, '/');
+    file = (file != NULL) ? file + 1 : path;
+    for (end = file + strlen(file), i = 0; i < 3; i++) {
+        while (end > file && *end != '-') {
+            end--;
+        }
+        if (end == file) {
+            return NULL;
+        }
+        if (i < 2) {
+            end--;
+        }
+    }
+
+    str_alloc(&pkgname, end - file + 1);
+    memcpy(pkgname, file, end - file);
+    pkgname[end - file] = '\0';
+
+    return pkgname;
 }
 
+// the repo of a split pkgbase is only removed along with the last of its
+// installed packages.
 void uninstall(List *list) {
 
     char *str = NULL;
+    const char *pkgbase;
+    int fd;
+    List *installed, *pkg, *temp;
+    bool keep;
     
+	installed = get_installed_list();
 	get_str(&str, UNINSTALL, NULL);
-	while (list != NULL) {
-		str_alloc(&str, strlen(str) + strlen(list->pkgname) + 2);
+	for (temp = list; temp != NULL; temp = temp->next) {
+		str_alloc(&str, strlen(str) + strlen(temp->pkgname) + 2);
 		strcat(str, " ");
-		strcat(str, list->pkgname);
-		if (is_dir(list->pkgname) == true) {
-			remove_dir(list->pkgname);
+		strcat(str, temp->pkgname);
+
+		pkg = find_pkg(installed, temp->pkgname);
+		pkgbase = (pkg != NULL) ? pkg_base(pkg) : temp->pkgname;
+		for (keep = false, pkg = installed; pkg != NULL; pkg = pkg->next) {
+			if (strcmp(pkg_base(pkg), pkgbase) == 0 && find_pkg(list, pkg->pkgname) == NULL) {
+				keep = true;
+			}
+		}
+		if (keep == false && is_dir(pkgbase) == true) {
+			fd = lock_pkg(pkgbase);
+			remove_dir(pkgbase);
+			unlock(fd);
 		}
-		list = list->next;
 	}
 	system(str);
 
+	clear_list(installed);
 	free(str);
 }
 
+// drop the clones of packages that are no longer installed and whatever
+// else is over the size cap, see cache.c.
 void clean(void) {
 
-    char *str = NULL;
-    List *dir, *pacman, *rpc_pkg, *temp1, *temp2;
-
-    
-    dir = get_dir_list();
-	if (dir == NULL) {
+	printf("Cleaning aurx cache dir...\n");
+	if (cache_trim(true) == 0) {
 		printf("Nothing to do.\n");
-		return;
 	}
-
-	pacman = get_installed_list();
-	printf("Cleaning aurx cache dir...\n");
-    for (temp1 = pacman, temp2 = dir; dir != NULL; dir = dir->next) {
-        remove_dir(dir->pkgname);
-		if (pacman != NULL) {
-			pacman = pacman->next;
-		}
-    }
-	free(str);
-    clear_list(temp1);
-    clear_list(temp2);
 }
 
 void print_search(char *pkgname) {
 
     char *str = NULL;
     List *rpc_pkglist, *temp;
+    Store *store;
 	 
-    get_str(&str, AUR_SEARCH, pkgname);
-    rpc_pkglist = get_rpc_data(str);
+    store = store_load();
+    if (store != NULL) {
+        rpc_pkglist = store_search(store, pkgname);
+        store_free(store);
+    } else {
+        get_str(&str, AUR_SEARCH, pkgname);
+        rpc_pkglist = get_rpc_data(str);
+    }
 
 	if (rpc_pkglist == NULL) {
 		printf("No results found for: %s.\n", pkgname);
@@ -289,12 +790,20 @@ void print_installed(void) {
 }
 
 
+// the pkgbase comes from a .SRCINFO nobody reviewed yet and ends up in
+// shell commands, only accept what makepkg allows in a pkgname.
+bool valid_pkgname(const char *name) {
+
+	return name[0] != '\0' && name[0] != '-' && name[0] != '.' && strlen(name) < NAME_LEN && \
+		strspn(name, "abcdefghijklmnopqrstuvwxyz0123456789@._+-") == strlen(name);
+}
+
 // check if an epoch has been added to a PKGBUILD that wasnt present in
 // the installed version. without this, if the "pkgver" is 
 // higher than the "epoch" (1), the epoch update will be ignored.
-bool epoch_update(List *pkg, char *pkgver) {
+bool epoch_update(List *pkg, const char *pkgver) {
 
-	char *installed_pkgver, *update_pkgver;
+	const char *installed_pkgver, *update_pkgver;
 	
 	installed_pkgver = pkg->pkgver;
 	update_pkgver = pkgver;
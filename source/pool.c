@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "../include/pool.h"
+#include "../include/memory.h"
+#include "../include/util.h"
+
+typedef struct pool {
+    Job job;
+    void *arg;
+    int n;
+    int next;
+    pthread_mutex_t lock;
+} Pool;
+
+void *worker(void *p);
+
+int pool_size(void) {
+
+    long n;
+
+    n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1) {
+        return 1;
+    }
+    return n;
+}
+
+// call job(i, arg) for every i in [0, n) using at most "threads" threads.
+// returns once every job has finished.
+void run_pool(int threads, int n, Job job, void *arg) {
+
+    Pool pool;
+    pthread_t *tid;
+    register int i;
+
+    if (threads > n) {
+        threads = n;
+    }
+    if (threads <= 1) {
+        for (i = 0; i < n; i++) {
+            job(i, arg);
+        }
+        return;
+    }
+
+    pool.job = job;
+    pool.arg = arg;
+    pool.n = n;
+    pool.next = 0;
+    pthread_mutex_init(&pool.lock, NULL);
+
+    tid = array_alloc(NULL, threads * sizeof(pthread_t));
+    for (i = 0; i < threads; i++) {
+        if (pthread_create(&tid[i], NULL, worker, &pool) != 0) {
+            printf(BRED"ERROR:"BOLD" Failed to start worker thread.\n"RESET);
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (i = 0; i < threads; i++) {
+        pthread_join(tid[i], NULL);
+    }
+
+    pthread_mutex_destroy(&pool.lock);
+    free(tid);
+}
+
+void *worker(void *p) {
+
+    Pool *pool = p;
+    int i;
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        i = pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (i >= pool->n) {
+            break;
+        }
+        pool->job(i, pool->arg);
+    }
+
+    return NULL;
+}
@@ -0,0 +1,442 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <elf.h>
+#include <glob.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <alpm.h>
+
+#include "../include/rebuild.h"
+#include "../include/operation.h"
+#include "../include/memory.h"
+#include "../include/list.h"
+#include "../include/util.h"
+#include "../include/pool.h"
+
+typedef struct elf_file {
+    char *path;
+    int pkg;
+    char *missing;          // first soname that didn't resolve, NULL if none
+} Elf_file;
+
+typedef struct scan {
+    Elf_file *files;
+    int n_files;
+    alpm_filelist_t **pkg_files;
+    char **lib_dirs;        // from /etc/ld.so.conf.d
+    int n_lib_dirs;
+} Scan;
+
+// PT_DYNAMIC of a mapped ELF file of either class.
+typedef struct dynamic {
+    bool elf32;
+    const char *dyn;
+    size_t n_dyn;
+    const char *strings;    // the dynamic string table
+    size_t strsz;
+} Dynamic;
+
+void scan_file(int i, void *arg);
+char *check_needed(Scan *scan, Elf_file *file, const char *map, size_t size);
+bool read_dynamic(const char *map, size_t size, bool elf32, Dynamic *dynamic);
+Elf64_Phdr read_phdr(const char *phdrs, bool elf32, size_t k);
+Elf64_Dyn read_dyn(const Dynamic *dynamic, size_t k);
+bool resolve(Scan *scan, Elf_file *file, const char *soname, const char *rpath, bool elf32);
+bool in_dir(const char *dir, const char *origin, const char *soname);
+bool skip_path(const char *path);
+void read_ld_conf(Scan *scan);
+
+// report foreign packages linking against sonames that no longer resolve,
+// typically after a repo library bump, and offer to rebuild them.
+void rebuild(void) {
+
+    alpm_handle_t *pac_handle;
+    alpm_errno_t err;
+    alpm_db_t *local_db;
+    alpm_pkg_t *pkg;
+    alpm_filelist_t *filelist;
+    List *pkglist, *temp, *broken;
+    Scan scan = {NULL, 0, NULL, NULL, 0};
+    char **pkgnames = NULL;
+    int n_pkgs = 0, cap = 0, last = -1;
+    register int i;
+    size_t j;
+
+    pkglist = get_installed_list();
+    if (pkglist == NULL) {
+        printf("No installed AUR packages found.\n");
+        return;
+    }
+
+    pac_handle = alpm_initialize("/", "/var/lib/pacman/", &err);
+    if (pac_handle == NULL) {
+        printf(BRED"ERROR:"BOLD" alpm_initialize %s\n"RESET, alpm_strerror(err));
+        exit(EXIT_FAILURE);
+    }
+    local_db = alpm_get_localdb(pac_handle);
+
+    // flatten every candidate file of every foreign package into one array for the pool.
+    for (temp = pkglist; temp != NULL; temp = temp->next) {
+        pkg = alpm_db_get_pkg(local_db, temp->pkgname);
+        if (pkg == NULL) {
+            continue;
+        }
+        pkgnames = array_alloc(pkgnames, (n_pkgs + 1) * sizeof(char *));
+        scan.pkg_files = array_alloc(scan.pkg_files, (n_pkgs + 1) * sizeof(alpm_filelist_t *));
+        pkgnames[n_pkgs] = temp->pkgname;
+        filelist = alpm_pkg_get_files(pkg);
+        scan.pkg_files[n_pkgs] = filelist;
+
+        for (j = 0; j < filelist->count; j++) {
+            if (skip_path(filelist->files[j].name)) {
+                continue;
+            }
+            if (scan.n_files == cap) {
+                cap = cap ? cap * 2 : 1024;
+                scan.files = array_alloc(scan.files, cap * sizeof(Elf_file));
+            }
+            scan.files[scan.n_files].path = NULL;
+            get_str(&scan.files[scan.n_files].path, "/%s", filelist->files[j].name);
+            scan.files[scan.n_files].pkg = n_pkgs;
+            scan.files[scan.n_files].missing = NULL;
+            scan.n_files++;
+        }
+        n_pkgs++;
+    }
+    read_ld_conf(&scan);
+
+    printf(BBLUE"::"BOLD" Checking %d files from %d foreign packages for missing libraries...\n"RESET, scan.n_files, n_pkgs);
+    run_pool(pool_size() * 2, scan.n_files, scan_file, &scan);
+
+    broken = list_malloc();
+    for (i = 0; i < scan.n_files; i++) {
+        if (scan.files[i].missing == NULL) {
+            continue;
+        }
+        if (scan.files[i].pkg != last) {
+            broken = add_pkgname(broken, pkgnames[scan.files[i].pkg]);
+            last = scan.files[i].pkg;
+        }
+        printf(" %-30s"BRED"%-30s"GREY"%s\n"RESET, pkgnames[scan.files[i].pkg], scan.files[i].missing, scan.files[i].path);
+    }
+
+    for (i = 0; i < scan.n_files; i++) {
+        free(scan.files[i].path);
+        free(scan.files[i].missing);
+    }
+    for (i = 0; i < scan.n_lib_dirs; i++) {
+        free(scan.lib_dirs[i]);
+    }
+    free(scan.files);
+    free(scan.lib_dirs);
+    free(scan.pkg_files);
+    free(pkgnames);
+    alpm_release(pac_handle);
+    clear_list(pkglist);
+
+    if (broken->pkgname == NULL) {
+        printf(" Nothing to do.\n");
+        clear_list(broken);
+        return;
+    }
+
+    printf(BBLUE"::"BOLD" Rebuild affected packages? [Y/n] "RESET);
+    if (prompt() == true) {
+        force_update(broken);
+    }
+    clear_list(broken);
+}
+
+void scan_file(int i, void *arg) {
+
+    Scan *scan = arg;
+    Elf_file *file = &scan->files[i];
+    struct stat st;
+    char *map;
+    int fd;
+
+    fd = open(file->path, O_RDONLY | O_NOFOLLOW);
+    if (fd < 0) {
+        return;
+    }
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size < (off_t)sizeof(Elf32_Ehdr)) {
+        close(fd);
+        return;
+    }
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return;
+    }
+    if (memcmp(map, ELFMAG, SELFMAG) == 0) {
+        file->missing = check_needed(scan, file, map, st.st_size);
+    }
+    munmap(map, st.st_size);
+}
+
+// returns a copy of the first unresolved DT_NEEDED entry.
+char *check_needed(Scan *scan, Elf_file *file, const char *map, size_t size) {
+
+    Dynamic dynamic;
+    Elf64_Dyn dyn;
+    const char *rpath = NULL;
+    char *missing = NULL;
+    bool elf32;
+    size_t k;
+
+    if (map[EI_CLASS] == ELFCLASS64 && size >= sizeof(Elf64_Ehdr)) {
+        elf32 = false;
+    } else if (map[EI_CLASS] == ELFCLASS32) {
+        elf32 = true;
+    } else {
+        return NULL;
+    }
+    if (read_dynamic(map, size, elf32, &dynamic) == false) {
+        return NULL;
+    }
+
+    for (k = 0; k < dynamic.n_dyn; k++) {
+        dyn = read_dyn(&dynamic, k);
+        if (dyn.d_tag == DT_NULL) {
+            break;
+        }
+        if ((dyn.d_tag == DT_RUNPATH || dyn.d_tag == DT_RPATH) && dyn.d_un.d_val < dynamic.strsz && \
+            memchr(dynamic.strings + dyn.d_un.d_val, '\0', dynamic.strsz - dyn.d_un.d_val) != NULL) {
+            rpath = dynamic.strings + dyn.d_un.d_val;
+        }
+    }
+    for (k = 0; k < dynamic.n_dyn; k++) {
+        dyn = read_dyn(&dynamic, k);
+        if (dyn.d_tag == DT_NULL) {
+            break;
+        }
+        if (dyn.d_tag == DT_NEEDED && dyn.d_un.d_val < dynamic.strsz && \
+            memchr(dynamic.strings + dyn.d_un.d_val, '\0', dynamic.strsz - dyn.d_un.d_val) != NULL && \
+            resolve(scan, file, dynamic.strings + dyn.d_un.d_val, rpath, elf32) == false) {
+            get_str(&missing, "%s", dynamic.strings + dyn.d_un.d_val);
+            return missing;
+        }
+    }
+
+    return NULL;
+}
+
+// locate PT_DYNAMIC and its string table, false when the file is malformed
+// or not dynamically linked.
+bool read_dynamic(const char *map, size_t size, bool elf32, Dynamic *dynamic) {
+
+    Elf64_Phdr ph;
+    Elf64_Dyn dyn;
+    size_t k, phoff, phnum, phentsize, strtab = 0;
+    bool found_strtab = false;
+
+    if (elf32) {
+        phoff = ((const Elf32_Ehdr *)map)->e_phoff;
+        phnum = ((const Elf32_Ehdr *)map)->e_phnum;
+    } else {
+        phoff = ((const Elf64_Ehdr *)map)->e_phoff;
+        phnum = ((const Elf64_Ehdr *)map)->e_phnum;
+    }
+    // compare by subtraction, offsets from a malformed file would wrap a sum.
+    phentsize = elf32 ? sizeof(Elf32_Phdr) : sizeof(Elf64_Phdr);
+    if (phoff > size || phnum > (size - phoff) / phentsize) {
+        return false;
+    }
+
+    dynamic->elf32 = elf32;
+    dynamic->dyn = NULL;
+    dynamic->n_dyn = 0;
+    dynamic->strsz = 0;
+    for (k = 0; k < phnum; k++) {
+        ph = read_phdr(map + phoff, elf32, k);
+        if (ph.p_type == PT_DYNAMIC && ph.p_offset <= size && ph.p_filesz <= size - ph.p_offset) {
+            dynamic->dyn = map + ph.p_offset;
+            dynamic->n_dyn = ph.p_filesz / (elf32 ? sizeof(Elf32_Dyn) : sizeof(Elf64_Dyn));
+        }
+    }
+    if (dynamic->dyn == NULL) {
+        return false;
+    }
+
+    for (k = 0; k < dynamic->n_dyn; k++) {
+        dyn = read_dyn(dynamic, k);
+        if (dyn.d_tag == DT_NULL) {
+            break;
+        }
+        if (dyn.d_tag == DT_STRTAB) {
+            strtab = dyn.d_un.d_ptr;
+        } else if (dyn.d_tag == DT_STRSZ) {
+            dynamic->strsz = dyn.d_un.d_val;
+        }
+    }
+
+    // DT_STRTAB is a virtual address, map it back to a file offset.
+    for (k = 0; k < phnum; k++) {
+        ph = read_phdr(map + phoff, elf32, k);
+        if (ph.p_type == PT_LOAD && strtab >= ph.p_vaddr && strtab - ph.p_vaddr < ph.p_filesz) {
+            strtab = strtab - ph.p_vaddr + ph.p_offset;
+            found_strtab = true;
+            break;
+        }
+    }
+    if (!found_strtab || strtab > size || dynamic->strsz > size - strtab) {
+        return false;
+    }
+    dynamic->strings = map + strtab;
+
+    return true;
+}
+
+// program header k of either class, widened to the 64-bit layout.
+Elf64_Phdr read_phdr(const char *phdrs, bool elf32, size_t k) {
+
+    const Elf32_Phdr *ph32;
+    Elf64_Phdr ph;
+
+    if (elf32 == false) {
+        memcpy(&ph, phdrs + k * sizeof(Elf64_Phdr), sizeof(ph));
+        return ph;
+    }
+    ph32 = (const Elf32_Phdr *)phdrs + k;
+    ph.p_type = ph32->p_type;
+    ph.p_offset = ph32->p_offset;
+    ph.p_vaddr = ph32->p_vaddr;
+    ph.p_filesz = ph32->p_filesz;
+
+    return ph;
+}
+
+Elf64_Dyn read_dyn(const Dynamic *dynamic, size_t k) {
+
+    const Elf32_Dyn *dyn32;
+    Elf64_Dyn dyn;
+
+    if (dynamic->elf32 == false) {
+        memcpy(&dyn, dynamic->dyn + k * sizeof(Elf64_Dyn), sizeof(dyn));
+        return dyn;
+    }
+    dyn32 = (const Elf32_Dyn *)dynamic->dyn + k;
+    dyn.d_tag = dyn32->d_tag;
+    dyn.d_un.d_val = dyn32->d_un.d_val;
+
+    return dyn;
+}
+
+bool resolve(Scan *scan, Elf_file *file, const char *soname, const char *rpath, bool elf32) {
+
+    char dir[MAX_BUFFER], origin[MAX_BUFFER], *slash;
+    const char *p, *end;
+    alpm_filelist_t *filelist;
+    size_t j, len;
+    register int i;
+
+    if (strchr(soname, '/') != NULL) {
+        return access(soname, F_OK) == 0;
+    }
+
+    strncpy(origin, file->path, MAX_BUFFER - 1);
+    origin[MAX_BUFFER - 1] = '\0';
+    slash = strrchr(origin, '/');
+    if (slash != NULL) {
+        *slash = '\0';
+    }
+
+    for (p = rpath; p != NULL && *p != '\0'; p = (*end == ':') ? end + 1 : end) {
+        end = strchr(p, ':');
+        if (end == NULL) {
+            end = p + strlen(p);
+        }
+        len = end - p;
+        if (len > 0 && len < MAX_BUFFER) {
+            memcpy(dir, p, len);
+            dir[len] = '\0';
+            if (in_dir(dir, origin, soname)) {
+                return true;
+            }
+        }
+    }
+
+    if (in_dir(elf32 ? "/usr/lib32" : "/usr/lib", NULL, soname)) {
+        return true;
+    }
+    for (i = 0; i < scan->n_lib_dirs; i++) {
+        if (in_dir(scan->lib_dirs[i], NULL, soname)) {
+            return true;
+        }
+    }
+
+    // private libraries loaded through a wrapper's LD_LIBRARY_PATH.
+    filelist = scan->pkg_files[file->pkg];
+    len = strlen(soname);
+    for (j = 0; j < filelist->count; j++) {
+        p = filelist->files[j].name;
+        end = p + strlen(p);
+        if ((size_t)(end - p) >= len && strcmp(end - len, soname) == 0 && \
+            (end - p == (ptrdiff_t)len || *(end - len - 1) == '/')) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool in_dir(const char *dir, const char *origin, const char *soname) {
+
+    char path[MAX_BUFFER];
+
+    if (origin != NULL && strncmp(dir, "$ORIGIN", 7) == 0) {
+        snprintf(path, MAX_BUFFER, "%s%s/%s", origin, dir + 7, soname);
+    } else if (origin != NULL && strncmp(dir, "${ORIGIN}", 9) == 0) {
+        snprintf(path, MAX_BUFFER, "%s%s/%s", origin, dir + 9, soname);
+    } else {
+        snprintf(path, MAX_BUFFER, "%s/%s", dir, soname);
+    }
+
+    return access(path, F_OK) == 0;
+}
+
+// directories and data-only trees never contain ELF objects worth opening.
+bool skip_path(const char *path) {
+
+    size_t len = strlen(path);
+
+    return len == 0 || path[len - 1] == '/' || \
+        strncmp(path, "usr/share/", 10) == 0 || \
+        strncmp(path, "usr/include/", 12) == 0 || \
+        strncmp(path, "etc/", 4) == 0;
+}
+
+void read_ld_conf(Scan *scan) {
+
+    glob_t conf;
+    FILE *f;
+    char line[MAX_BUFFER], *p;
+    size_t j;
+
+    if (glob("/etc/ld.so.conf.d/*.conf", 0, NULL, &conf) != 0) {
+        return;
+    }
+    for (j = 0; j < conf.gl_pathc; j++) {
+        f = fopen(conf.gl_pathv[j], "r");
+        if (f == NULL) {
+            continue;
+        }
+        while (fgets(line, MAX_BUFFER, f) != NULL) {
+            line[strcspn(line, "#\n")] = '\0';
+            for (p = line; *p == ' ' || *p == '\t'; p++);
+            if (*p != '/') {
+                continue;
+            }
+            scan->lib_dirs = array_alloc(scan->lib_dirs, (scan->n_lib_dirs + 1) * sizeof(char *));
+            scan->lib_dirs[scan->n_lib_dirs] = NULL;
+            get_str(&scan->lib_dirs[scan->n_lib_dirs], "%s", p);
+            scan->n_lib_dirs++;
+        }
+        fclose(f);
+    }
+    globfree(&conf);
+}
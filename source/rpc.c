@@ -1,5 +1,7 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 #include <curl/curl.h>
 #include <json-c/json.h>
 
@@ -7,9 +9,26 @@
 #include "../include/memory.h"
 #include "../include/list.h"
 #include "../include/util.h"
+#include "../include/store.h"
+#include "../include/lock.h"
 
 size_t callback(char *data, size_t size, size_t nmemb, Json_buffer *p);
 size_t write_meta(char *data, size_t size, size_t nmemb, FILE *p);
+void curl_setup(void);
+
+static pthread_once_t curl_once = PTHREAD_ONCE_INIT;
+
+// curl_global_init() is not thread-safe, libaurx handles may query from
+// several threads. it runs once and is never cleaned up.
+void curl_init(void) {
+
+    pthread_once(&curl_once, curl_setup);
+}
+
+void curl_setup(void) {
+
+    curl_global_init(CURL_GLOBAL_ALL);
+}
 
 List *get_rpc_data(char *url) {
 
@@ -27,12 +46,63 @@ List *get_rpc_data(char *url) {
     return temp;
 } 
 
+// fetch n urls with up to RPC_JOBS transfers in flight, calling
+// done(i, list, arg) as each response arrives. done owns the list.
+void get_rpc_multi(char **urls, int n, Rpc_callback done, void *arg) {
+
+    CURLM *multi;
+    CURL *curl;
+    CURLMsg *msg;
+    Json_buffer **buffers;
+    int running = 0, queued;
+    long i;
+    register int next;
+
+    curl_init();
+    multi = curl_multi_init();
+    buffers = array_alloc(NULL, (n + 1) * sizeof(Json_buffer *));
+
+    for (next = 0; next < n || running > 0;) {
+        for (; next < n && running < RPC_JOBS; next++, running++) {
+            buffers[next] = json_buffer_malloc();
+            curl = curl_easy_init();
+            curl_easy_setopt(curl, CURLOPT_URL, urls[next]);
+            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, callback);
+            curl_easy_setopt(curl, CURLOPT_WRITEDATA, buffers[next]);
+            curl_easy_setopt(curl, CURLOPT_PRIVATE, (void *)(long)next);
+            curl_multi_add_handle(multi, curl);
+        }
+
+        curl_multi_perform(multi, &queued);
+        while ((msg = curl_multi_info_read(multi, &queued)) != NULL) {
+            if (msg->msg != CURLMSG_DONE) {
+                continue;
+            }
+            curl = msg->easy_handle;
+            curl_easy_getinfo(curl, CURLINFO_PRIVATE, (char **)&i);
+            curl_multi_remove_handle(multi, curl);
+            curl_easy_cleanup(curl);
+            running--;
+
+            done(i, json(buffers[i]->response), arg);
+            free(buffers[i]->response);
+            free(buffers[i]);
+        }
+        if (running > 0) {
+            curl_multi_poll(multi, NULL, 0, 1000, NULL);
+        }
+    }
+
+    free(buffers);
+    curl_multi_cleanup(multi);
+}
+
 char *curl(Json_buffer *buffer, char *url) {
     
     CURLcode res;
     CURL *curl;
 
-    curl_global_init(CURL_GLOBAL_ALL);
+    curl_init();
     curl = curl_easy_init();
     
     if(curl != NULL) {
@@ -44,7 +114,6 @@ char *curl(Json_buffer *buffer, char *url) {
         res = curl_easy_perform(curl);
 
         curl_easy_cleanup(curl);
-        curl_global_cleanup();
     }
 
     return buffer->response;
@@ -63,19 +132,25 @@ size_t callback(char *data, size_t size, size_t nmemb, Json_buffer *p) {
     return len;
 }
 
-// not being used yet.
+// download the metadata dump and rebuild the package store from it.
 void fetch_meta(void) {
 
     FILE *p;
     CURLcode res;
     CURL *curl;
+    int fd;
 
-    curl_global_init(CURL_GLOBAL_ALL);
+    curl_init();
     curl = curl_easy_init();
     
     if(curl != NULL) {
 
+        fd = lock_file(META_LOCK, true);
         p = fopen(META, "w");
+        if (p == NULL) {
+            printf(BRED"ERROR:"BOLD" Failed to open %s.\n"RESET, META);
+            exit(EXIT_FAILURE);
+        }
         curl_easy_setopt(curl, CURLOPT_URL, META_LINK);
         curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_meta);
         curl_easy_setopt(curl, CURLOPT_WRITEDATA, p);
@@ -84,11 +159,16 @@ void fetch_meta(void) {
         fclose(p);
         
         curl_easy_cleanup(curl);
-        curl_global_cleanup();
+
+        if (res != CURLE_OK) {
+            printf(BRED"ERROR:"BOLD" Failed to download AUR metadata.\n"RESET);
+        } else {
+            store_build();
+        }
+        unlock(fd);
     }
 }
 
-// not being used yet.
 size_t write_meta(char *data, size_t size, size_t nmemb, FILE *p) {
     
     return fwrite(data, size, nmemb, p);
@@ -97,12 +177,12 @@ size_t write_meta(char *data, size_t size, size_t nmemb, FILE *p) {
 List *json(char *json_data) {
 
     register int i, n_results;
-    json_object *root, *results, *name, *pop, *version, *pkg, *desc;
+    json_object *root, *results, *name, *pop, *version, *base, *pkg, *desc;
     List *temp;
     
     root = json_tokener_parse(json_data);
     results = json_object_object_get(root, "results");
-    n_results = json_object_array_length(results);
+    n_results = (results == NULL) ? 0 : json_object_array_length(results);
     if (n_results == 0) {
         json_object_put(root);
         return NULL;
@@ -114,10 +194,12 @@ List *json(char *json_data) {
         
         name = json_object_object_get(pkg, "Name");
         version = json_object_object_get(pkg, "Version");
+        base = json_object_object_get(pkg, "PackageBase");
         pop = json_object_object_get(pkg, "Popularity");
 
         temp = add_json_data(temp, json_object_get_string(name), \
                             json_object_get_string(version), \
+                            json_object_get_string(base), \
                             json_object_get_int(pop));
     }
     json_object_put(root);
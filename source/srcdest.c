@@ -0,0 +1,338 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <utime.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+#include <curl/curl.h>
+
+#include "../include/srcdest.h"
+#include "../include/memory.h"
+#include "../include/list.h"
+#include "../include/util.h"
+#include "../include/srcinfo.h"
+#include "../include/pool.h"
+#include "../include/lock.h"
+#include "../include/rpc.h"
+
+// source downloads are keyed by checksum so identical tarballs are stored
+// once, and makepkg finds them under their usual filename through a hard link.
+typedef struct source {
+    char *filename;
+    char *url;
+    char *object;       // OBJECTS_DIR/<algo>-<sum>
+    const char *tool;   // coreutils command verifying the object
+} Source;
+
+typedef struct object {
+    char *path;
+    long long size;
+    time_t mtime;       // last used
+} Object;
+
+Source *get_sources(const char *pkgname, int *n);
+void free_sources(Source *sources, int n);
+List *get_arch_values(const char *pkgname, const char *key);
+void download(int i, void *arg);
+int scan_sources(const char *path, Object **objects, int n, long long *total);
+size_t write_source(char *data, size_t size, size_t nmemb, FILE *p);
+int compare_objects(const void *a, const void *b);
+
+typedef struct algo {
+    const char *key;
+    const char *tool;
+    size_t len;         // hex digits of a sum
+} Algo;
+
+static const Algo algos[] = {
+    {"b2sums", "b2sum", 128},
+    {"sha512sums", "sha512sum", 128},
+    {"sha256sums", "sha256sum", 64},
+    {"sha224sums", "sha224sum", 56},
+    {"sha384sums", "sha384sum", 96},
+    {"sha1sums", "sha1sum", 40},
+    {"md5sums", "md5sum", 32},
+};
+
+// download the sources of a whole batch in parallel before any build starts.
+void source_prefetch(List *pkglist) {
+
+    Source *sources, *jobs = NULL;
+    int n, n_jobs = 0, fd;
+    register int i, j;
+
+    fd = lock_file(SOURCES_LOCK, true);
+    mkdir(SOURCES_DIR, 0755);
+    mkdir(OBJECTS_DIR, 0755);
+
+    for (; pkglist != NULL; pkglist = pkglist->next) {
+        sources = get_sources(pkglist->pkgname, &n);
+        for (i = 0; i < n; i++) {
+            if (file_exists(sources[i].object) == true) {
+                utime(sources[i].object, NULL);        // most recently used
+                continue;
+            }
+            for (j = 0; j < n_jobs && strcmp(jobs[j].object, sources[i].object) != 0; j++);
+            if (j < n_jobs) {
+                continue;
+            }
+            jobs = array_alloc(jobs, (n_jobs + 1) * sizeof(Source));
+            jobs[n_jobs] = sources[i];
+            sources[i].filename = sources[i].url = sources[i].object = NULL;
+            n_jobs++;
+        }
+        free_sources(sources, n);
+    }
+
+    if (n_jobs > 0) {
+        printf(BBLUE"::"BOLD" Downloading %d sources...\n"RESET, n_jobs);
+        curl_init();
+        run_pool(SOURCE_JOBS, n_jobs, download, jobs);
+    }
+    free_sources(jobs, n_jobs);
+
+    source_trim();
+    unlock(fd);
+}
+
+// hard link the objects of a package into its clone, where makepkg looks
+// before SRCDEST. the clone is only built under the package lock, so builds
+// sharing a filename like v1.0.tar.gz can't relink it under each other, and
+// an object evicted by a concurrent trim stays reachable through the link.
+void source_link(const char *pkgname) {
+
+    char *path = NULL;
+    Source *sources;
+    struct stat st;
+    int n, fd;
+    register int i;
+
+    fd = lock_file(SOURCES_LOCK, false);
+    sources = get_sources(pkgname, &n);
+    for (i = 0; i < n; i++) {
+        if (file_exists(sources[i].object) == false) {
+            continue;
+        }
+        str_alloc(&path, strlen(pkgname) + strlen(sources[i].filename) + 2);
+        sprintf(path, "%s/%s", pkgname, sources[i].filename);
+        if (lstat(path, &st) == 0) {
+            // files shipped in the repo have no other link.
+            if (!S_ISREG(st.st_mode) || st.st_nlink == 1) {
+                continue;
+            }
+            unlink(path);
+        }
+        link(sources[i].object, path);
+        utime(sources[i].object, NULL);
+    }
+    free(path);
+    free_sources(sources, n);
+    unlock(fd);
+}
+
+// evict the least recently used files until the store fits in SOURCES_MAX.
+// makepkg's own downloads in SRCDEST (VCS-less sources aurx couldn't
+// prefetch) share the budget. the caller holds SOURCES_LOCK exclusively.
+void source_trim(void) {
+
+    Object *objects = NULL;
+    long long total = 0;
+    int n;
+    register int i;
+
+    n = scan_sources(OBJECTS_DIR, &objects, 0, &total);
+    n = scan_sources(SOURCES_DIR, &objects, n, &total);
+
+    qsort(objects, n, sizeof(Object), compare_objects);
+    for (i = 0; i < n; i++) {
+        if (total > SOURCES_MAX) {
+            remove(objects[i].path);
+            total -= objects[i].size;
+        }
+        free(objects[i].path);
+    }
+    free(objects);
+}
+
+// append the regular files of dir, last used is the later of the access
+// and modification time since makepkg only reads a download again.
+int scan_sources(const char *path, Object **objects, int n, long long *total) {
+
+    DIR *dir;
+    struct dirent *p;
+    struct stat st;
+    char file[MAX_BUFFER];
+
+    dir = opendir(path);
+    if (dir == NULL) {
+        return n;
+    }
+    while ((p = readdir(dir)) != NULL) {
+        snprintf(file, MAX_BUFFER, "%s/%s", path, p->d_name);
+        if (p->d_name[0] == '.' || lstat(file, &st) < 0 || !S_ISREG(st.st_mode)) {
+            continue;
+        }
+        *objects = array_alloc(*objects, (n + 1) * sizeof(Object));
+        (*objects)[n].path = NULL;
+        get_str(&(*objects)[n].path, "%s", file);
+        (*objects)[n].size = st.st_size;
+        (*objects)[n].mtime = (st.st_atime > st.st_mtime) ? st.st_atime : st.st_mtime;
+        *total += st.st_size;
+        n++;
+    }
+    closedir(dir);
+
+    return n;
+}
+
+// downloadable sources of a package with a usable checksum, VCS and local
+// sources are left to makepkg.
+Source *get_sources(const char *pkgname, int *n) {
+
+    List *source, *sums = NULL, *s, *c;
+    Source *sources = NULL;
+    char *url, *filename, *slash, *colons;
+    const Algo *algo = NULL;
+    register int i;
+
+    *n = 0;
+    source = get_arch_values(pkgname, "source");
+    for (i = 0; i < (int)(sizeof(algos) / sizeof(algos[0])) && sums == NULL; i++) {
+        sums = get_arch_values(pkgname, algos[i].key);
+        algo = &algos[i];
+    }
+
+    for (s = source, c = sums; s != NULL && c != NULL; s = s->next, c = c->next) {
+        colons = strstr(s->pkgname, "::");
+        url = (colons != NULL) ? colons + 2 : s->pkgname;
+        // the sum names the object and reaches the shell, and this runs
+        // before the PKGBUILD was reviewed.
+        if (strlen(c->pkgname) != algo->len || strspn(c->pkgname, "0123456789abcdef") != algo->len || \
+            strchr(url, '\'') != NULL || \
+            (strncmp(url, "https://", 8) != 0 && strncmp(url, "http://", 7) != 0 && strncmp(url, "ftp://", 6) != 0)) {
+            continue;
+        }
+        if (colons != NULL) {
+            *colons = '\0';
+            filename = s->pkgname;
+        } else {
+            slash = strrchr(url, '/');
+            filename = slash + 1;
+        }
+        if (*filename == '\0' || *filename == '.' || strchr(filename, '/') != NULL) {
+            continue;
+        }
+
+        sources = array_alloc(sources, (*n + 1) * sizeof(Source));
+        sources[*n].filename = sources[*n].url = sources[*n].object = NULL;
+        get_str(&sources[*n].filename, "%s", filename);
+        get_str(&sources[*n].url, "%s", url);
+        str_alloc(&sources[*n].object, strlen(OBJECTS_DIR) + strlen(algo->tool) + strlen(c->pkgname) + 3);
+        sprintf(sources[*n].object, OBJECTS_DIR"/%s-%s", algo->tool, c->pkgname);
+        sources[*n].tool = algo->tool;
+        (*n)++;
+    }
+
+    clear_list(source);
+    clear_list(sums);
+    return sources;
+}
+
+void free_sources(Source *sources, int n) {
+
+    register int i;
+
+    for (i = 0; i < n; i++) {
+        free(sources[i].filename);
+        free(sources[i].url);
+        free(sources[i].object);
+    }
+    free(sources);
+}
+
+// "key" followed by "key_<arch>", which is how .SRCINFO lists arch specific arrays.
+List *get_arch_values(const char *pkgname, const char *key) {
+
+    struct utsname un;
+    char arch_key[NAME_LEN];
+    List *list, *arch, *temp;
+
+    list = srcinfo_get(pkgname, key);
+    if (uname(&un) < 0) {
+        return list;
+    }
+    snprintf(arch_key, NAME_LEN, "%s_%s", key, un.machine);
+    arch = srcinfo_get(pkgname, arch_key);
+    if (list == NULL) {
+        return arch;
+    }
+    for (temp = list; temp->next != NULL; temp = temp->next);
+    temp->next = arch;
+
+    return list;
+}
+
+void download(int i, void *arg) {
+
+    Source *source = &((Source *)arg)[i];
+    char *tmp = NULL, *cmd = NULL, *sum;
+    const char *expected;
+    CURLcode res;
+    CURL *curl;
+    FILE *p;
+
+    str_alloc(&tmp, strlen(source->object) + 6);
+    sprintf(tmp, "%s.part", source->object);
+    p = fopen(tmp, "w");
+    curl = curl_easy_init();
+    if (p == NULL || curl == NULL) {
+        if (p != NULL) {
+            fclose(p);
+        }
+        free(tmp);
+        return;
+    }
+
+    curl_easy_setopt(curl, CURLOPT_URL, source->url);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_source);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, p);
+    res = curl_easy_perform(curl);
+    curl_easy_cleanup(curl);
+    fclose(p);
+
+    // only keep what matches the checksum the object is named after.
+    expected = strrchr(source->object, '-') + 1;
+    if (res == CURLE_OK) {
+        str_alloc(&cmd, strlen(CHECKSUM) + strlen(source->tool) + strlen(tmp));
+        sprintf(cmd, CHECKSUM, source->tool, tmp);
+        sum = get_buffer(cmd);
+        if (sum != NULL && strncmp(sum, expected, strlen(expected)) == 0 && sum[strlen(expected)] == ' ') {
+            rename(tmp, source->object);
+        } else {
+            printf(BYELLOW"WARNING:"BOLD" Checksum mismatch for %s.\n"RESET, source->filename);
+        }
+        free(sum);
+        free(cmd);
+    } else {
+        printf(BYELLOW"WARNING:"BOLD" Failed to download %s: %s\n"RESET, source->filename, curl_easy_strerror(res));
+    }
+
+    remove(tmp);
+    free(tmp);
+}
+
+size_t write_source(char *data, size_t size, size_t nmemb, FILE *p) {
+
+    return fwrite(data, size, nmemb, p);
+}
+
+int compare_objects(const void *a, const void *b) {
+
+    const Object *x = a, *y = b;
+
+    return (x->mtime > y->mtime) - (x->mtime < y->mtime);
+}
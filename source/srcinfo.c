@@ -0,0 +1,453 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "../include/srcinfo.h"
+#include "../include/memory.h"
+#include "../include/list.h"
+#include "../include/util.h"
+#include "../include/lock.h"
+
+typedef struct record {
+    Srcinfo_record header;
+    char *blob;
+    bool changed;           // reparsed by this process
+} Record;
+
+List *parse_srcinfo(const char *dir, const char *key);
+Record *get_record(const char *dir);
+bool read_record(const char *dir, Srcinfo_record *header);
+bool indexed(const char *key);
+void index_read(void);
+int load_index(Record **out);
+void index_write(void);
+void write_records(FILE *f, Record *list, int n, uint32_t *written);
+
+static Record *records;
+static int n_records;
+static bool loaded, dirty;
+static char *cache_dir;      // records are relative to it
+
+// every value of "key" in a repo's .SRCINFO, in file order.
+List *srcinfo_get(const char *dir, const char *key) {
+
+    Record *record;
+    const char *p, *end, *value;
+    List *list;
+    uint32_t i;
+
+    if (indexed(key) == false) {
+        return parse_srcinfo(dir, key);
+    }
+    record = get_record(dir);
+    if (record == NULL) {
+        return NULL;
+    }
+
+    list = list_malloc();
+    p = record->blob + strlen(record->blob) + 1;
+    end = record->blob + record->header.blob_len;
+    for (i = 0; i < record->header.n_pairs && p < end; i++) {
+        value = p + strlen(p) + 1;
+        if (strcmp(p, key) == 0) {
+            // add_pkgname() keeps duplicates, which checksums rely on.
+            list = add_pkgname(list, value);
+        }
+        p = value + strlen(value) + 1;
+    }
+
+    if (list->pkgname == NULL) {
+        clear_list(list);
+        return NULL;
+    }
+    return list;
+}
+
+// every value of key, or of every indexed key with key NULL, straight
+// from the file.
+List *parse_srcinfo(const char *dir, const char *key) {
+
+    FILE *f;
+    char *path = NULL, line[MAX_BUFFER], *p, *value;
+    List *list, *last;
+
+    get_str(&path, SRCINFO, dir);
+    f = fopen(path, "r");
+    free(path);
+    if (f == NULL) {
+        return NULL;
+    }
+
+    list = list_malloc();
+    while (fgets(line, MAX_BUFFER, f) != NULL) {
+        line[strcspn(line, "\n")] = '\0';
+        for (p = line; *p == '\t' || *p == ' '; p++);
+        value = strstr(p, " = ");
+        if (value == NULL) {
+            continue;
+        }
+        *value = '\0';
+        value += 3;
+        if (key != NULL ? strcmp(p, key) != 0 : indexed(p) == false) {
+            continue;
+        }
+
+        // add_pkgname() keeps duplicates, which checksums rely on. for the
+        // index the key is kept in pkgver.
+        list = add_pkgname(list, value);
+        if (key == NULL) {
+            for (last = list; last->next != NULL; last = last->next);
+            str_alloc(&last->pkgver, strlen(p) + 1);
+            strcpy(last->pkgver, p);
+        }
+    }
+    fclose(f);
+
+    if (list->pkgname == NULL) {
+        clear_list(list);
+        return NULL;
+    }
+    return list;
+}
+
+// full version as alpm and the RPC print it: [epoch:]pkgver-pkgrel.
+char *srcinfo_version(const char *dir) {
+
+    char *epoch, *pkgver, *pkgrel, *version = NULL;
+
+    pkgver = srcinfo_first(dir, "pkgver");
+    pkgrel = srcinfo_first(dir, "pkgrel");
+    if (pkgver == NULL || pkgrel == NULL) {
+        free(pkgver);
+        free(pkgrel);
+        return NULL;
+    }
+    epoch = srcinfo_first(dir, "epoch");
+
+    str_alloc(&version, (epoch ? strlen(epoch) + 1 : 0) + strlen(pkgver) + strlen(pkgrel) + 2);
+    if (epoch != NULL) {
+        sprintf(version, "%s:%s-%s", epoch, pkgver, pkgrel);
+    } else {
+        sprintf(version, "%s-%s", pkgver, pkgrel);
+    }
+
+    free(epoch);
+    free(pkgver);
+    free(pkgrel);
+    return version;
+}
+
+char *srcinfo_first(const char *dir, const char *key) {
+
+    List *list;
+    char *value;
+
+    list = srcinfo_get(dir, key);
+    if (list == NULL) {
+        return NULL;
+    }
+    value = list->pkgname;
+    list->pkgname = NULL;
+    clear_list(list);
+
+    return value;
+}
+
+// the index record of dir, reparsed when it is missing or stale.
+Record *get_record(const char *dir) {
+
+    Srcinfo_record header;
+    List *pairs, *temp;
+    Record *record = NULL;
+    size_t len;
+    char *p;
+    register int i;
+
+    if (loaded == false) {
+        index_read();
+    }
+    if (read_record(dir, &header) == false) {
+        return NULL;
+    }
+
+    for (i = 0; i < n_records; i++) {
+        if (strcmp(records[i].blob, dir) == 0) {
+            record = &records[i];
+            break;
+        }
+    }
+    if (record != NULL && memcmp(&record->header, &header, offsetof(Srcinfo_record, n_pairs)) == 0) {
+        return record;
+    }
+
+    if (record == NULL) {
+        records = array_alloc(records, (n_records + 1) * sizeof(Record));
+        record = &records[n_records++];
+        record->blob = NULL;
+    }
+    record->changed = true;
+    pairs = parse_srcinfo(dir, NULL);
+    for (len = strlen(dir) + 1, temp = pairs; temp != NULL; temp = temp->next) {
+        len += strlen(temp->pkgver) + strlen(temp->pkgname) + 2;
+        header.n_pairs++;
+    }
+    header.blob_len = len;
+    str_alloc(&record->blob, len);
+    p = stpcpy(record->blob, dir) + 1;
+    for (temp = pairs; temp != NULL; temp = temp->next) {
+        p = stpcpy(p, temp->pkgver) + 1;
+        p = stpcpy(p, temp->pkgname) + 1;
+    }
+    record->header = header;
+    clear_list(pairs);
+    dirty = true;
+
+    return record;
+}
+
+// the key of a record: HEAD and the .SRCINFO's stat. false without a .SRCINFO.
+bool read_record(const char *dir, Srcinfo_record *header) {
+
+    char *path = NULL;
+    struct stat st;
+    int res;
+
+    get_str(&path, SRCINFO, dir);
+    res = stat(path, &st);
+    free(path);
+    if (res < 0) {
+        return false;
+    }
+
+    memset(header, 0, sizeof(Srcinfo_record));
+    read_head(dir, header->head);
+    header->mtime = st.st_mtim.tv_sec;
+    header->mtime_nsec = st.st_mtim.tv_nsec;
+    header->size = st.st_size;
+
+    return true;
+}
+
+// commit id of HEAD, from the loose ref or packed-refs. left empty when
+// it can't be resolved.
+void read_head(const char *dir, char *head) {
+
+    FILE *f;
+    char *path = NULL, line[MAX_BUFFER], ref[MAX_BUFFER], *name;
+    size_t len;
+
+    get_str(&path, "%s/.git/HEAD", dir);
+    f = fopen(path, "r");
+    if (f == NULL) {
+        free(path);
+        return;
+    }
+    if (fgets(line, MAX_BUFFER, f) == NULL) {
+        fclose(f);
+        free(path);
+        return;
+    }
+    fclose(f);
+    line[strcspn(line, "\n")] = '\0';
+    if (strncmp(line, "ref: ", 5) != 0) {
+        snprintf(head, HEAD_LEN, "%s", line);     // detached
+        free(path);
+        return;
+    }
+    snprintf(ref, MAX_BUFFER, "%s", line + 5);
+
+    str_alloc(&path, strlen(dir) + strlen(ref) + 7);
+    sprintf(path, "%s/.git/%s", dir, ref);
+    f = fopen(path, "r");
+    if (f != NULL) {
+        if (fgets(line, MAX_BUFFER, f) != NULL) {
+            line[strcspn(line, "\n")] = '\0';
+            snprintf(head, HEAD_LEN, "%s", line);
+        }
+        fclose(f);
+        free(path);
+        return;
+    }
+
+    // "<id> <ref>" lines once git gc packed the ref.
+    get_str(&path, "%s/.git/packed-refs", dir);
+    f = fopen(path, "r");
+    free(path);
+    if (f == NULL) {
+        return;
+    }
+    len = strlen(ref);
+    while (fgets(line, MAX_BUFFER, f) != NULL) {
+        line[strcspn(line, "\n")] = '\0';
+        name = strchr(line, ' ');
+        if (name != NULL && strlen(name + 1) == len && strcmp(name + 1, ref) == 0) {
+            *name = '\0';
+            snprintf(head, HEAD_LEN, "%s", line);
+            break;
+        }
+    }
+    fclose(f);
+}
+
+// keys aurx reads, including their _<arch> variants.
+bool indexed(const char *key) {
+
+    static const char *keys[] = {"pkgbase", "pkgname", "pkgver", "pkgrel", "epoch", "arch", "depends", \
+                                "makedepends", "checkdepends", "source", NULL};
+    const char *sums;
+    size_t len;
+    register int i;
+
+    for (i = 0; keys[i] != NULL; i++) {
+        len = strlen(keys[i]);
+        if (strncmp(key, keys[i], len) == 0 && (key[len] == '\0' || key[len] == '_')) {
+            return true;
+        }
+    }
+    sums = strstr(key, "sums");
+    return sums != NULL && (sums[4] == '\0' || sums[4] == '_');
+}
+
+// load the whole index once, it is written back at exit when a record changed.
+void index_read(void) {
+
+    char cwd[MAX_BUFFER];
+    int fd;
+
+    loaded = true;
+    if (getcwd(cwd, MAX_BUFFER) == NULL) {
+        return;
+    }
+    get_str(&cache_dir, "%s", cwd);
+    atexit(index_write);
+
+    fd = lock_file(INDEX_LOCK, false);
+    n_records = load_index(&records);
+    unlock(fd);
+}
+
+// the records of the index file, a damaged tail only costs the records in it.
+int load_index(Record **out) {
+
+    FILE *f;
+    char magic[8];
+    uint32_t n, i;
+    Record *list = NULL, *record;
+    int n_list = 0;
+
+    *out = NULL;
+    f = fopen(SRCINFO_INDEX, "r");
+    if (f == NULL) {
+        return 0;
+    }
+    if (fread(magic, sizeof(magic), 1, f) != 1 || memcmp(magic, SRCINFO_MAGIC, sizeof(magic)) != 0 || \
+        fread(&n, sizeof(n), 1, f) != 1) {
+        fclose(f);
+        return 0;
+    }
+
+    for (i = 0; i < n; i++) {
+        list = array_alloc(list, (n_list + 1) * sizeof(Record));
+        record = &list[n_list];
+        record->blob = NULL;
+        record->changed = false;
+        if (fread(&record->header, sizeof(Srcinfo_record), 1, f) != 1 || \
+            record->header.blob_len == 0 || record->header.blob_len > SRCINFO_MAX_RECORD) {
+            break;
+        }
+        str_alloc(&record->blob, record->header.blob_len);
+        if (fread(record->blob, 1, record->header.blob_len, f) != record->header.blob_len || \
+            record->blob[record->header.blob_len - 1] != '\0') {
+            free(record->blob);
+            break;
+        }
+        n_list++;
+    }
+    fclose(f);
+
+    *out = list;
+    return n_list;
+}
+
+// other aurx processes may have refreshed records since this one loaded
+// the index, so it is read again under the lock: records reparsed here
+// replace theirs, the rest of the file is kept as is.
+void index_write(void) {
+
+    FILE *f;
+    char *tmp = NULL;
+    Record *disk;
+    uint32_t n = 0;
+    int n_disk, fd;
+    register int i, j;
+
+    if (dirty == false || cache_dir == NULL || chdir(cache_dir) < 0) {
+        return;
+    }
+
+    fd = lock_file(INDEX_LOCK, true);
+    n_disk = load_index(&disk);
+    for (i = 0; i < n_disk; i++) {
+        for (j = 0; j < n_records && strcmp(records[j].blob, disk[i].blob) != 0; j++);
+        if (j < n_records && records[j].changed == false) {
+            free(records[j].blob);
+            records[j].header = disk[i].header;
+            records[j].blob = disk[i].blob;
+            disk[i].blob = NULL;
+        }
+        if (j < n_records) {
+            free(disk[i].blob);
+            disk[i].blob = NULL;
+        }
+    }
+
+    str_alloc(&tmp, strlen(SRCINFO_INDEX) + 24);
+    sprintf(tmp, SRCINFO_INDEX".%d", (int)getpid());
+    f = fopen(tmp, "w");
+    if (f != NULL) {
+        fwrite(SRCINFO_MAGIC, 8, 1, f);
+        fwrite(&n, sizeof(n), 1, f);
+        write_records(f, records, n_records, &n);
+        write_records(f, disk, n_disk, &n);
+        fseek(f, 8, SEEK_SET);
+        fwrite(&n, sizeof(n), 1, f);
+        if (fclose(f) == 0) {
+            rename(tmp, SRCINFO_INDEX);
+        } else {
+            remove(tmp);
+        }
+    }
+    unlock(fd);
+
+    for (i = 0; i < n_disk; i++) {
+        free(disk[i].blob);
+    }
+    free(disk);
+    free(tmp);
+}
+
+// records of removed repos are dropped on the way.
+void write_records(FILE *f, Record *list, int n, uint32_t *written) {
+
+    char *path = NULL;
+    struct stat st;
+    register int i;
+
+    for (i = 0; i < n; i++) {
+        if (list[i].blob == NULL) {
+            continue;
+        }
+        get_str(&path, SRCINFO, list[i].blob);
+        if (stat(path, &st) < 0) {
+            continue;
+        }
+        fwrite(&list[i].header, sizeof(Srcinfo_record), 1, f);
+        fwrite(list[i].blob, 1, list[i].header.blob_len, f);
+        (*written)++;
+    }
+    free(path);
+}
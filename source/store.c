@@ -0,0 +1,405 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include <json-c/json.h>
+
+#include "../include/store.h"
+#include "../include/memory.h"
+#include "../include/list.h"
+#include "../include/util.h"
+#include "../include/lock.h"
+
+char *read_meta(void);
+char *next_object(char *p, char **end);
+void append_str(char **blob, uint32_t *len, uint32_t *cap, const char *str);
+int compare_rows(const void *a, const void *b);
+int compare_hits(const void *a, const void *b);
+bool check_store(Store *store, uint32_t blob_len);
+
+static const char *sort_blob;
+static const uint32_t *sort_name;
+
+// a search match, sorted without globals so libaurx handles can search
+// from several threads.
+typedef struct hit {
+    int32_t pop;
+    uint32_t row;
+} Hit;
+
+// convert the metadata dump into the columnar store file. each package
+// object is parsed on its own so the whole dump never sits in json-c at once.
+void store_build(void) {
+
+    char *meta, *p, *end, save, *names = NULL, *vers = NULL, *bases = NULL, *tmp = NULL;
+    const char *pkgname, *pkgbase;
+    uint32_t n = 0, cap = 0, names_len = 0, names_cap = 0, vers_len = 0, vers_cap = 0;
+    uint32_t bases_len = 0, bases_cap = 0, i;
+    uint32_t *name = NULL, *ver = NULL, *base = NULL, *index = NULL;
+    int32_t *pop = NULL;
+    json_object *pkg;
+    Store_header header;
+    FILE *f;
+
+    meta = read_meta();
+    if (meta == NULL) {
+        printf(BRED"ERROR:"BOLD" Failed to read %s.\n"RESET, META);
+        return;
+    }
+
+    for (p = next_object(meta, &end); p != NULL; p = next_object(end, &end)) {
+        save = *end;
+        *end = '\0';
+        pkg = json_tokener_parse(p);
+        *end = save;
+        if (pkg == NULL) {
+            continue;
+        }
+
+        if (n == cap) {
+            cap = cap ? cap * 2 : 4096;
+            name = array_alloc(name, cap * sizeof(uint32_t));
+            ver = array_alloc(ver, cap * sizeof(uint32_t));
+            base = array_alloc(base, cap * sizeof(uint32_t));
+            pop = array_alloc(pop, cap * sizeof(int32_t));
+        }
+        pkgname = json_object_get_string(json_object_object_get(pkg, "Name"));
+        pkgbase = json_object_get_string(json_object_object_get(pkg, "PackageBase"));
+        name[n] = names_len;
+        append_str(&names, &names_len, &names_cap, pkgname);
+        ver[n] = vers_len;
+        append_str(&vers, &vers_len, &vers_cap, json_object_get_string(json_object_object_get(pkg, "Version")));
+        if (pkgbase == NULL || pkgname == NULL || strcmp(pkgname, pkgbase) == 0) {
+            base[n] = STORE_NO_BASE;
+        } else {
+            base[n] = bases_len;
+            append_str(&bases, &bases_len, &bases_cap, pkgbase);
+        }
+        pop[n] = json_object_get_int(json_object_object_get(pkg, "Popularity"));
+        n++;
+
+        json_object_put(pkg);
+    }
+    free(meta);
+
+    // versions follow the names in the blob, then the pkgbases.
+    for (i = 0; i < n; i++) {
+        ver[i] += names_len;
+        if (base[i] != STORE_NO_BASE) {
+            base[i] += names_len + vers_len;
+        }
+    }
+
+    index = array_alloc(NULL, (n ? n : 1) * sizeof(uint32_t));
+    for (i = 0; i < n; i++) {
+        index[i] = i;
+    }
+    sort_blob = names;
+    sort_name = name;
+    qsort(index, n, sizeof(uint32_t), compare_rows);
+
+    memcpy(header.magic, STORE_MAGIC, sizeof(header.magic));
+    header.n = n;
+    header.blob_len = names_len + vers_len + bases_len;
+
+    get_str(&tmp, "%s.tmp", STORE);
+    f = fopen(tmp, "w");
+    if (f == NULL) {
+        printf(BRED"ERROR:"BOLD" Failed to write %s.\n"RESET, STORE);
+    } else {
+        fwrite(&header, sizeof(header), 1, f);
+        fwrite(name, sizeof(uint32_t), n, f);
+        fwrite(ver, sizeof(uint32_t), n, f);
+        fwrite(base, sizeof(uint32_t), n, f);
+        fwrite(pop, sizeof(int32_t), n, f);
+        fwrite(index, sizeof(uint32_t), n, f);
+        fwrite(names, 1, names_len, f);
+        fwrite(vers, 1, vers_len, f);
+        fwrite(bases, 1, bases_len, f);
+        if (fclose(f) == 0) {
+            rename(tmp, STORE);
+        }
+    }
+
+    free(tmp);
+    free(name);
+    free(ver);
+    free(base);
+    free(pop);
+    free(index);
+    free(names);
+    free(vers);
+    free(bases);
+}
+
+// map the store file, returns NULL when it is missing, stale or damaged so
+// callers can fall back to the RPC.
+Store *store_load(void) {
+
+    return store_open(".");
+}
+
+// same for the cache dir dir, libaurx never changes the working directory.
+Store *store_open(const char *dir) {
+
+    char *path = NULL;
+    int fd, lock;
+    struct stat st;
+    Store *store;
+    const Store_header *header;
+    const char *p;
+
+    // the mapping stays valid after unlocking, store_build() replaces the
+    // file by renaming over it.
+    get_str(&path, "%s/"META_LOCK, dir);
+    lock = lock_file(path, false);
+    get_str(&path, "%s/"STORE, dir);
+    fd = open(path, O_RDONLY);
+    unlock(lock);
+    free(path);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &st) < 0 || time(NULL) - st.st_mtime > META_MAX_AGE || \
+        (size_t)st.st_size < sizeof(Store_header)) {
+        close(fd);
+        return NULL;
+    }
+
+    store = store_malloc();
+    store->map_size = st.st_size;
+    store->map = mmap(NULL, store->map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (store->map == MAP_FAILED) {
+        free(store);
+        return NULL;
+    }
+
+    header = store->map;
+    if (memcmp(header->magic, STORE_MAGIC, sizeof(header->magic)) != 0 || \
+        sizeof(Store_header) + (size_t)header->n * 20 + header->blob_len != store->map_size) {
+        store_free(store);
+        return NULL;
+    }
+
+    p = (const char *)store->map + sizeof(Store_header);
+    store->n = header->n;
+    store->name = (const uint32_t *)p;
+    store->ver = store->name + store->n;
+    store->base = store->ver + store->n;
+    store->pop = (const int32_t *)(store->base + store->n);
+    store->index = (const uint32_t *)(store->pop + store->n);
+    store->blob = (const char *)(store->index + store->n);
+    if (!check_store(store, header->blob_len)) {
+        store_free(store);
+        return NULL;
+    }
+
+    return store;
+}
+
+void store_free(Store *store) {
+
+    if (store == NULL) {
+        return;
+    }
+    if (store->map != NULL && store->map != MAP_FAILED) {
+        munmap(store->map, store->map_size);
+    }
+    free(store);
+}
+
+// binary search on the name index, returns the row or -1.
+int store_find(Store *store, const char *pkgname) {
+
+    int low, high, mid, cmp;
+
+    for (low = 0, high = store->n - 1; low <= high;) {
+        mid = low + (high - low) / 2;
+        cmp = strcmp(store->blob + store->name[store->index[mid]], pkgname);
+        if (cmp == 0) {
+            return store->index[mid];
+        } else if (cmp < 0) {
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+
+    return -1;
+}
+
+const char *store_pkgname(Store *store, int row) {
+
+    return store->blob + store->name[row];
+}
+
+const char *store_pkgver(Store *store, int row) {
+
+    return store->blob + store->ver[row];
+}
+
+const char *store_pkgbase(Store *store, int row) {
+
+    if (store->base[row] == STORE_NO_BASE) {
+        return store->blob + store->name[row];
+    }
+    return store->blob + store->base[row];
+}
+
+// same semantics as the RPC search by name: substring match, ordered by popularity.
+// matches are sorted once and appended at the tail, add_json_data() would walk
+// the list for every hit.
+List *store_search(Store *store, const char *keyword) {
+
+    uint32_t i, k = 0;
+    Hit *hits;
+    List *list = NULL, *tail = NULL, *temp;
+
+    hits = array_alloc(NULL, (store->n ? store->n : 1) * sizeof(Hit));
+    for (i = 0; i < store->n; i++) {
+        if (strstr(store->blob + store->name[i], keyword) != NULL) {
+            hits[k].pop = store->pop[i];
+            hits[k++].row = i;
+        }
+    }
+    qsort(hits, k, sizeof(Hit), compare_hits);
+
+    for (i = 0; i < k; i++) {
+        temp = add_json_data(list_malloc(), store->blob + store->name[hits[i].row], \
+                            store->blob + store->ver[hits[i].row], store_pkgbase(store, hits[i].row), hits[i].pop);
+        if (tail == NULL) {
+            list = temp;
+        } else {
+            tail->next = temp;
+        }
+        tail = temp;
+    }
+    free(hits);
+
+    return list;
+}
+
+// every offset must point into the blob and the blob must end in a NUL,
+// otherwise a damaged file would send strcmp() past the mapping.
+bool check_store(Store *store, uint32_t blob_len) {
+
+    uint32_t i;
+
+    if (blob_len == 0 || store->blob[blob_len - 1] != '\0') {
+        return false;
+    }
+    for (i = 0; i < store->n; i++) {
+        if (store->name[i] >= blob_len || store->ver[i] >= blob_len || \
+            (store->base[i] != STORE_NO_BASE && store->base[i] >= blob_len) || \
+            store->index[i] >= store->n) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// zlib reads plain files as well, so this works whether or not the
+// server already decoded the dump.
+char *read_meta(void) {
+
+    gzFile gz;
+    char *buffer = NULL;
+    int len = 0, cap = 1 << 20, res;
+
+    gz = gzopen(META, "rb");
+    if (gz == NULL) {
+        return NULL;
+    }
+
+    str_alloc(&buffer, cap);
+    while ((res = gzread(gz, buffer + len, cap - len - 1)) > 0) {
+        len += res;
+        if (cap - len - 1 == 0) {
+            cap *= 2;
+            str_alloc(&buffer, cap);
+        }
+    }
+    gzclose(gz);
+
+    if (res < 0) {
+        free(buffer);
+        return NULL;
+    }
+    buffer[len] = '\0';
+
+    return buffer;
+}
+
+// find the next top level object of the array, *end is set past its closing brace.
+char *next_object(char *p, char **end) {
+
+    char *start;
+    int depth = 0;
+    bool string = false;
+
+    while (*p != '\0' && *p != '{') {
+        p++;
+    }
+    if (*p == '\0') {
+        return NULL;
+    }
+
+    for (start = p; *p != '\0'; p++) {
+        if (string) {
+            if (*p == '\\' && p[1] != '\0') {
+                p++;
+            } else if (*p == '"') {
+                string = false;
+            }
+        } else if (*p == '"') {
+            string = true;
+        } else if (*p == '{') {
+            depth++;
+        } else if (*p == '}' && --depth == 0) {
+            *end = p + 1;
+            return start;
+        }
+    }
+
+    return NULL;
+}
+
+void append_str(char **blob, uint32_t *len, uint32_t *cap, const char *str) {
+
+    uint32_t n;
+
+    if (str == NULL) {
+        str = "";
+    }
+    n = strlen(str) + 1;
+    if (*len + n > *cap) {
+        *cap = (*len + n) * 2;
+        str_alloc(blob, *cap);
+    }
+    memcpy(*blob + *len, str, n);
+    *len += n;
+}
+
+int compare_rows(const void *a, const void *b) {
+
+    return strcmp(sort_blob + sort_name[*(const uint32_t *)a], \
+                sort_blob + sort_name[*(const uint32_t *)b]);
+}
+
+// most popular first, ties keep the order of the dump like add_json_data() did.
+int compare_hits(const void *a, const void *b) {
+
+    const Hit *x = a, *y = b;
+
+    if (x->pop != y->pop) {
+        return (x->pop < y->pop) ? 1 : -1;
+    }
+    return (x->row > y->row) - (x->row < y->row);
+}
@@ -6,17 +6,19 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#define UTIL_INTERNAL
 #include "../include/util.h"
 #include "../include/memory.h"
 #include "../include/list.h"
 
-// pipe output of commands to a buffer and return the buffer.
+// pipe output of commands to a buffer and return the buffer. under MEMSTAT
+// this and get_str() charge their allocations to the caller set by util.h.
 char *get_buffer(const char *cmd) {
 	
 	char *temp_buffer = NULL, *temp = NULL;
 	FILE *p;
 	
-	str_alloc(&temp_buffer, MAX_BUFFER);
+	(str_alloc)(&temp_buffer, MAX_BUFFER);
 
 	p = popen(cmd, "r");
 	if (p == NULL) {
@@ -31,7 +33,7 @@ char *get_buffer(const char *cmd) {
 		return NULL;
 	}
 
-	str_alloc(&temp, (strlen(temp_buffer) + 1));
+	(str_alloc)(&temp, (strlen(temp_buffer) + 1));
 	strcpy(temp, temp_buffer);
 	free(temp_buffer);
 
@@ -42,10 +44,10 @@ char *get_buffer(const char *cmd) {
 void get_str(char **p, const char *str, const char *str_var) {
 	
 	if (str_var != NULL) {
-		str_alloc(p, strlen(str) + strlen(str_var) - 1);
+		(str_alloc)(p, strlen(str) + strlen(str_var) - 1);
 		sprintf(*p, str, str_var);
 	} else {
-		str_alloc(p, strlen(str) + 1);
+		(str_alloc)(p, strlen(str) + 1);
 		sprintf(*p, str);
 	}
 }
@@ -67,7 +69,7 @@ bool prompt(void) {
     }
 }
 
-bool file_exists(char *path) {
+bool file_exists(const char *path) {
 	
 	FILE *f;
 	int result;
@@ -81,7 +83,7 @@ bool file_exists(char *path) {
 	return false;
 }
 
-bool is_dir(char *pkgname) {
+bool is_dir(const char *pkgname) {
 
 	DIR* dir = opendir(pkgname);
 	if (dir != NULL) {
@@ -93,7 +95,7 @@ bool is_dir(char *pkgname) {
 }
 
 // remove directories recursively.
-void remove_dir(char *path) {
+void remove_dir(const char *path) {
 
 	DIR *dir;
 	struct dirent *p;
@@ -143,7 +145,7 @@ List *get_dir_list(void) {
 	dir_list = list_malloc();
 
 	while ((p = readdir(dir)) != NULL) {
-		if (strcmp(p->d_name, ".") == 0 || strcmp(p->d_name, "..") == 0) {
+		if (p->d_name[0] == '.') {		// skip . and .. as well as aurx's own metadata files.
 			continue;
 		}
 		dir_list = add_pkgname(dir_list, p->d_name);
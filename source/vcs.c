@@ -0,0 +1,271 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "../include/vcs.h"
+#include "../include/operation.h"
+#include "../include/memory.h"
+#include "../include/list.h"
+#include "../include/util.h"
+#include "../include/srcinfo.h"
+#include "../include/pool.h"
+#include "../include/lock.h"
+#include "../include/journal.h"
+
+typedef struct vcs_pkg {
+    const char *pkgname;
+    char *cmd;          // command printing the upstream revision first
+    char *rev;          // upstream revision, NULL if the check failed
+} Vcs_pkg;
+
+bool is_vcs(const char *pkgname);
+char *upstream_cmd(const char *pkgname);
+void check_upstream(int i, void *arg);
+char *read_rev(const char *pkgname);
+void write_rev(const char *pkgname, const char *rev);
+bool valid_ref(const char *ref);
+
+// the AUR version of VCS packages rarely changes, so compare the upstream
+// HEAD with the one recorded when the package was last built instead.
+void vcs_update(void) {
+
+    char *old;
+    List *pkglist, *temp, *updates;
+    Vcs_pkg *pkgs = NULL;
+    int n = 0, fd;
+    register int i;
+
+    pkglist = get_installed_list();
+    if (pkglist == NULL) {
+        printf("No installed AUR packages found.\n");
+        return;
+    }
+
+    // the builds below go through the -u journal, same as update().
+    fd = lock_file(JOURNAL_LOCK, true);
+
+    // the repo, and so the recorded revision, belongs to the pkgbase.
+    for (temp = pkglist; temp != NULL; temp = temp->next) {
+        if (is_vcs(pkg_base(temp)) == false || find_base(pkglist, pkg_base(temp)) != temp) {
+            continue;
+        }
+        if (is_dir(pkg_base(temp)) == false) {
+            fetch_update(pkg_base(temp), NULL);
+        }
+        pkgs = array_alloc(pkgs, (n + 1) * sizeof(Vcs_pkg));
+        pkgs[n].pkgname = pkg_base(temp);
+        pkgs[n].cmd = upstream_cmd(pkg_base(temp));
+        pkgs[n].rev = NULL;
+        n++;
+    }
+    if (n == 0) {
+        printf("No installed VCS packages found.\n");
+        clear_list(pkglist);
+        unlock(fd);
+        return;
+    }
+
+    printf(BBLUE"::"BOLD" Checking upstream of %d VCS packages...\n"RESET, n);
+    run_pool(VCS_JOBS, n, check_upstream, pkgs);
+
+    updates = list_malloc();
+    for (i = 0; i < n; i++) {
+        if (pkgs[i].cmd == NULL || pkgs[i].rev == NULL) {
+            printf(BYELLOW"WARNING:"BOLD" Could not check upstream of %s.\n"RESET, pkgs[i].pkgname);
+            continue;
+        }
+
+        old = read_rev(pkgs[i].pkgname);
+        if (old == NULL || strcmp(old, pkgs[i].rev) != 0) {
+            if (updates->pkgname == NULL) {
+                printf(BBLUE"::"BOLD" Upstream changed for:"RESET"\n\n");
+            }
+            printf(" %-30s"GREY"%-20.12s"RESET"-> "BGREEN"%.12s\n"RESET, pkgs[i].pkgname, old ? old : "unknown", pkgs[i].rev);
+            updates = add_pkgname(updates, pkgs[i].pkgname);
+        }
+        free(old);
+    }
+
+    if (updates->pkgname == NULL) {
+        printf(" Nothing to do.\n");
+    } else {
+        printf("\n"BBLUE"::"BOLD" Proceed with installation? [Y/n] "RESET);
+        if (prompt() == true) {
+            // the revisions live in the journal, vcs_commit() records them
+            // once installed, from this run or a resumed one. a package
+            // already built keeps the revision it was built from.
+            journal_begin(updates);
+            for (i = 0; i < n; i++) {
+                if (pkgs[i].rev != NULL && find_pkg(updates, pkgs[i].pkgname) != NULL && \
+                    journal_stage(pkgs[i].pkgname) < BUILT) {
+                    journal_set_rev(pkgs[i].pkgname, pkgs[i].rev);
+                }
+            }
+            run_updates(updates);
+        }
+    }
+
+    for (i = 0; i < n; i++) {
+        free(pkgs[i].cmd);
+        free(pkgs[i].rev);
+    }
+    free(pkgs);
+    clear_list(updates);
+    clear_list(pkglist);
+    unlock(fd);
+}
+
+// record the upstream revision a package was built from, only -d
+// updates have one in the journal.
+void vcs_commit(const char *pkgname) {
+
+    const char *rev;
+
+    rev = journal_rev(pkgname);
+    if (rev != NULL) {
+        mkdir(VCS_DIR, 0755);
+        write_rev(pkgname, rev);
+    }
+}
+
+bool is_vcs(const char *pkgname) {
+
+    const char *suffix[] = {"-git", "-svn", "-hg"};
+    size_t len, n;
+    register int i;
+
+    len = strlen(pkgname);
+    for (i = 0; i < 3; i++) {
+        n = strlen(suffix[i]);
+        if (len > n && strcmp(pkgname + len - n, suffix[i]) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// build the remote query for the first VCS source of the package,
+// e.g. "name::git+https://host/repo.git#branch=dev".
+char *upstream_cmd(const char *pkgname) {
+
+    char *cmd = NULL, *url, *fragment, ref[NAME_LEN] = "HEAD";
+    List *sources, *temp;
+
+    sources = srcinfo_get(pkgname, "source");
+    for (temp = sources; temp != NULL; temp = temp->next) {
+        url = strstr(temp->pkgname, "::");
+        url = (url != NULL) ? url + 2 : temp->pkgname;
+
+        fragment = strchr(url, '#');
+        if (fragment != NULL) {
+            *fragment++ = '\0';
+            if (strncmp(fragment, "commit=", 7) == 0 || strncmp(fragment, "revision=", 9) == 0) {
+                continue;       // pinned, upstream can't move.
+            }
+        }
+        if (strchr(url, '\'') != NULL) {
+            continue;
+        }
+
+        if (strncmp(url, "git+", 4) == 0 || strncmp(url, "git://", 6) == 0) {
+            if (fragment != NULL && strncmp(fragment, "branch=", 7) == 0) {
+                if (valid_ref(fragment + 7) == false) {
+                    continue;
+                }
+                snprintf(ref, NAME_LEN, "refs/heads/%s", fragment + 7);
+            } else if (fragment != NULL && strncmp(fragment, "tag=", 4) == 0) {
+                if (valid_ref(fragment + 4) == false) {
+                    continue;
+                }
+                snprintf(ref, NAME_LEN, "refs/tags/%s", fragment + 4);
+            }
+            if (strncmp(url, "git+", 4) == 0) {
+                url += 4;
+            }
+            str_alloc(&cmd, strlen(GIT_LS_REMOTE) + strlen(url) + strlen(ref));
+            sprintf(cmd, GIT_LS_REMOTE, url, ref);
+            break;
+        } else if (strncmp(url, "svn+", 4) == 0) {
+            get_str(&cmd, SVN_INFO, url + 4);
+            break;
+        } else if (strncmp(url, "hg+", 3) == 0) {
+            if (fragment != NULL && strncmp(fragment, "branch=", 7) == 0) {
+                if (valid_ref(fragment + 7) == false) {
+                    continue;
+                }
+                str_alloc(&cmd, strlen(HG_IDENTIFY_BRANCH) + strlen(url) + strlen(fragment));
+                sprintf(cmd, HG_IDENTIFY_BRANCH, fragment + 7, url + 3);
+            } else {
+                get_str(&cmd, HG_IDENTIFY, url + 3);
+            }
+            break;
+        }
+    }
+    clear_list(sources);
+
+    return cmd;
+}
+
+void check_upstream(int i, void *arg) {
+
+    Vcs_pkg *pkg = &((Vcs_pkg *)arg)[i];
+    char *buffer;
+
+    if (pkg->cmd == NULL) {
+        return;
+    }
+    buffer = get_buffer(pkg->cmd);
+    if (buffer == NULL) {
+        return;
+    }
+    buffer[strcspn(buffer, " \t\n")] = '\0';
+    if (buffer[0] == '\0') {
+        free(buffer);
+        return;
+    }
+    pkg->rev = buffer;
+}
+
+char *read_rev(const char *pkgname) {
+
+    FILE *f;
+    char *path = NULL, *rev = NULL, line[MAX_BUFFER];
+
+    get_str(&path, VCS_DIR"/%s", pkgname);
+    f = fopen(path, "r");
+    free(path);
+    if (f == NULL) {
+        return NULL;
+    }
+    if (fgets(line, MAX_BUFFER, f) != NULL) {
+        line[strcspn(line, "\n")] = '\0';
+        get_str(&rev, "%s", line);
+    }
+    fclose(f);
+
+    return rev;
+}
+
+void write_rev(const char *pkgname, const char *rev) {
+
+    FILE *f;
+    char *path = NULL;
+
+    get_str(&path, VCS_DIR"/%s", pkgname);
+    f = fopen(path, "w");
+    if (f != NULL) {
+        fprintf(f, "%s\n", rev);
+        fclose(f);
+    }
+    free(path);
+}
+
+// branch and tag names end up in a shell command, only accept what
+// git check-ref-format would.
+bool valid_ref(const char *ref) {
+
+    return ref[0] != '\0' && ref[0] != '-' && strstr(ref, "..") == NULL && \
+        strspn(ref, "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789._/-") == strlen(ref);
+}